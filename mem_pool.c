@@ -6,9 +6,20 @@
 *   M. Ryan Wingard
 */
 
+#ifdef __linux__
+#define _GNU_SOURCE // for MAP_FIXED_NOREPLACE
+#endif
+
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <assert.h>
 #include <stdio.h> // for perror()
+#include <time.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h> // for sysconf()
+#endif
 
 #include "mem_pool.h"
 
@@ -20,13 +31,41 @@ static const unsigned   MEM_POOL_STORE_INIT_CAPACITY    = 20;
 static const float      MEM_POOL_STORE_FILL_FACTOR      = 0.75;
 static const unsigned   MEM_POOL_STORE_EXPAND_FACTOR    = 2;
 
-static const unsigned   MEM_NODE_HEAP_INIT_CAPACITY     = 40;
+static const unsigned   MEM_NODE_CHUNK_CAPACITY         = 512; // the heap grows one fixed-size chunk at a time
 static const float      MEM_NODE_HEAP_FILL_FACTOR       = 0.75;
-static const unsigned   MEM_NODE_HEAP_EXPAND_FACTOR     = 2;
+static const unsigned   MEM_NODE_DIR_INIT_CAPACITY      = 8;
+static const unsigned   MEM_NODE_DIR_EXPAND_FACTOR      = 2;
 
 static const unsigned   MEM_GAP_IX_INIT_CAPACITY        = 40;
 static const float      MEM_GAP_IX_FILL_FACTOR          = 0.75;
 static const unsigned   MEM_GAP_IX_EXPAND_FACTOR        = 2;
+static const unsigned   MEM_GAP_IX_NONE                 = (unsigned) -1; // null link in the gap tree
+
+#define                 MEM_NUM_BINS                    64 // one size class per power of two
+#define                 MEM_NUM_SUBBIN_BITS             4  // TLSF splits each class 2^4 ways
+#define                 MEM_NUM_SUBBINS                 (1 << MEM_NUM_SUBBIN_BITS)
+static const unsigned   MEM_BIN_MAX_PROBES              = 8; // gaps tried in a request's own class
+
+static const unsigned   MEM_BUDDY_MIN_ORDER             = 4; // smallest buddy block is 2^4 bytes
+
+#define                 MEM_SLAB_SIZE                   4096 // one slab page, carved from a gap
+#define                 MEM_NUM_SLAB_CLASSES            8
+#define                 MEM_SLAB_MAX_OBJS               (MEM_SLAB_SIZE / 16)
+static const size_t     MEM_SLAB_CLASS_SIZE[MEM_NUM_SLAB_CLASSES] = { 16, 32, 48, 64, 96, 128, 192, 256 };
+static const unsigned   MEM_SLAB_DIR_INIT_CAPACITY      = 8;
+static const unsigned   MEM_SLAB_DIR_EXPAND_FACTOR      = 2;
+static const unsigned   MEM_NODE_SLAB                   = 2; // allocated value of a node holding a slab page
+
+static const unsigned   MEM_EXT_DIR_INIT_CAPACITY       = 4;
+static const unsigned   MEM_EXT_DIR_EXPAND_FACTOR       = 2;
+
+static const size_t     MEM_MAP_RESERVE_FACTOR          = 16; // address space mapped for a pool, in pool sizes
+static const size_t     MEM_HUGE_PAGE_SIZE              = 2 << 20; // POOL_HUGE_PAGES: mapping granularity
+static const size_t     MEM_PREFAULT_STRIDE             = 4096; // POOL_PREFAULT: smallest page size touched
+
+static const size_t     MEM_ARENA_ALIGN                 = 16; // arena records and the memory after them
+static const unsigned   MEM_ARENA_MARKS_INIT_CAPACITY   = 8;
+static const unsigned   MEM_ARENA_MARKS_EXPAND_FACTOR   = 2;
 
 /* Type declarations */
 typedef struct _node {
@@ -34,20 +73,90 @@ typedef struct _node {
     unsigned used;
     unsigned allocated;
     struct _node *next, *prev; // doubly-linked list for gap deletion
+    unsigned gap_slot; // the gap index entry of a gap node
 } node_t, *node_pt;
 
+// the gap index is an AVL tree ordered by (size, mem), or by mem alone for
+// FIRST_FIT and NEXT_FIT, stored in the gap_ix array and linked by slot numbers so that
+// realloc of gap_ix keeps it intact; SEGREGATED_FIT, TLSF and BUDDY pools
+// keep the same entries in size-class bins instead
 typedef struct _gap {
     size_t size;
+    char *mem;            // the gap's address, kept here so tree walks stay in gap_ix
     node_pt node;
+    unsigned left, right; // child slots, MEM_GAP_IX_NONE if absent
+    int height;
+    size_t max_size;      // largest gap in the subtree
+    unsigned bin_prev, bin_next; // neighbors in the size-class bin
 } gap_t, *gap_pt;
 
+// a slab page is one node of the pool, cut into objects of one size class;
+// the objects' allocation records are kept here, outside the pool
+typedef struct _slab {
+    node_pt node;                 // the node of the page, allocated == MEM_NODE_SLAB
+    unsigned cls;
+    unsigned num_objs;
+    unsigned num_free;
+    struct _slab *next, *prev;    // slabs of the class that have free objects
+    unsigned char free[MEM_SLAB_MAX_OBJS]; // stack of the free object numbers
+    alloc_t rec[];                // one record per object, size 0 while it is free
+} slab_t, *slab_pt;
+
+// memory added to a growable pool, after pool.mem; its nodes follow those
+// of the extents before it in the list, but never merge with them
+typedef struct _extent {
+    char *mem;
+    size_t size;
+} extent_t, *extent_pt;
+
+// a node of a batch deallocation, next to the offset in the pool it is
+// sorted by, so that sorting does not follow the node pointers
+typedef struct _node_key {
+    size_t offset;
+    node_pt node;
+} node_key_t, *node_key_pt;
+
 typedef struct _pool_mgr {
     pool_t pool;
-    node_pt node_heap;
+    node_pt node_heap;        // the first chunk, its first node heads the list
+    node_pt *node_dir;        // chunk directory, sorted by address
+    unsigned node_dir_size;
+    unsigned node_dir_capacity;
+    node_pt node_last;        // the chunk added last
     unsigned total_nodes;
     unsigned used_nodes;
+    node_pt node_free;        // unused nodes that have been used before, chained through .next
+    unsigned node_top;        // nodes of the last chunk at and above this one have never been used
     gap_pt gap_ix;
     unsigned gap_ix_capacity;
+    unsigned gap_ix_root;     // root slot of the gap tree
+    unsigned gap_ix_last;     // rightmost slot of the gap tree, the largest gap by (size, mem)
+    unsigned gap_ix_free;     // unused slots below gap_ix_top, chained through .left
+    unsigned gap_ix_top;      // slots at and above this one have never been used
+    unsigned bin_head[MEM_NUM_BINS][MEM_NUM_SUBBINS]; // first slot of each size-class bin
+    uint64_t bin_map;         // bit c is set iff some bin of class c is not empty
+    uint32_t subbin_map[MEM_NUM_BINS]; // bit s of entry c is set iff bin (c, s) is not empty
+    char *rover;              // NEXT_FIT resumes its search here, never inside a gap
+    size_t obj_size;          // FIXED_SIZE: the size of every slot
+    unsigned obj_count;
+    alloc_pt obj_rec;         // FIXED_SIZE: one allocation record per slot, handed out as is
+    unsigned *obj_free;       // FIXED_SIZE: stack of the free slot numbers
+    unsigned obj_free_top;
+    unsigned flags;           // the pool_flags it was opened with
+    slab_pt slab_part[MEM_NUM_SLAB_CLASSES]; // slabs of each class that have free objects
+    slab_pt *slab_dir;        // all slabs, sorted by address
+    unsigned slab_dir_size;
+    unsigned slab_dir_capacity;
+    char *arena_top;          // ARENA: the next allocation record goes here
+    char *arena_mark;         // ARENA: the top at the latest mark, below which nothing resizes
+    size_t *arena_marks;      // ARENA: the seq of each mark still on the stack, the latest last
+    unsigned arena_depth;
+    unsigned arena_marks_capacity;
+    size_t arena_seq;         // ARENA: the seq of the next mark
+    size_t map_size;          // the address space at pool.mem, with the reserve after the pool
+    extent_pt ext_dir;        // POOL_GROWABLE: the extents added, in the order they were
+    unsigned ext_dir_size;
+    unsigned ext_dir_capacity;
 } pool_mgr_t, *pool_mgr_pt;
 
 
@@ -60,10 +169,58 @@ static unsigned pool_store_capacity = 0;
 /* Forward declarations of static functions */
 static alloc_status _mem_resize_pool_store();
 static alloc_status _mem_resize_node_heap(pool_mgr_pt pool_mgr);
+static alloc_status _mem_expand_node_heap(pool_mgr_pt pool_mgr);
+static void _mem_free_node_heap(pool_mgr_pt pool_mgr);
+static void _mem_clear_node_heap(pool_mgr_pt pool_mgr);
+#ifdef __linux__
+static size_t _mem_map_granule(pool_mgr_pt pool_mgr);
+#endif
+static alloc_status _mem_map_pool(pool_mgr_pt pool_mgr, size_t size);
+static void _mem_unmap_pool(pool_mgr_pt pool_mgr);
+static void _mem_prefault(pool_mgr_pt pool_mgr, char *mem, size_t len);
+static alloc_status _mem_remap_pool(pool_mgr_pt pool_mgr, size_t size, size_t new_size);
+static size_t _mem_ext_total(pool_mgr_pt pool_mgr);
+static alloc_status _mem_reserve_nodes(pool_mgr_pt pool_mgr, unsigned count);
+static node_pt _mem_get_unused_node(pool_mgr_pt pool_mgr);
+static void _mem_put_unused_node(pool_mgr_pt pool_mgr, node_pt node);
+static node_pt _mem_node_of(pool_mgr_pt pool_mgr, alloc_pt alloc);
+static node_pt _mem_split_node(pool_mgr_pt pool_mgr, node_pt node, size_t size);
+static int _mem_contiguous(node_pt node, node_pt next);
+static alloc_status _mem_add_extent(pool_mgr_pt pool_mgr, size_t size);
+static size_t _mem_align_pad(const char *mem, size_t align);
+static unsigned _mem_find_gap(pool_mgr_pt pool_mgr, size_t size);
+static node_pt _mem_carve_node(pool_mgr_pt pool_mgr, size_t size, size_t align);
+static alloc_status _mem_release_node(pool_mgr_pt pool_mgr, node_pt node);
+static alloc_status _mem_resize_node(pool_mgr_pt pool_mgr, node_pt node, size_t size);
+static alloc_status _mem_carve_batch(pool_mgr_pt pool_mgr, const size_t *sizes, size_t n, alloc_pt *out);
+static node_key_pt _mem_sort_node_keys(node_key_pt keys, node_key_pt tmp, size_t count, size_t range);
+static void _mem_release_batch(pool_mgr_pt pool_mgr, node_key_pt keys, size_t count);
 static alloc_status _mem_resize_gap_ix(pool_mgr_pt pool_mgr);
+static void _mem_clear_gap_ix(pool_mgr_pt pool_mgr);
 static alloc_status _mem_add_to_gap_ix(pool_mgr_pt pool_mgr, size_t size, node_pt node);
 static alloc_status _mem_remove_from_gap_ix(pool_mgr_pt pool_mgr, size_t size, node_pt node);
-static alloc_status _mem_sort_gap_ix(pool_mgr_pt pool_mgr);
+static unsigned _mem_find_best_gap(pool_mgr_pt pool_mgr, size_t size);
+static unsigned _mem_find_first_gap(pool_mgr_pt pool_mgr, size_t size);
+static unsigned _mem_find_next_gap(pool_mgr_pt pool_mgr, unsigned slot, size_t size, const char *from);
+static unsigned _mem_find_binned_gap(pool_mgr_pt pool_mgr, size_t size);
+static unsigned _mem_find_tlsf_gap(pool_mgr_pt pool_mgr, size_t size);
+static unsigned _mem_buddy_order(size_t size);
+static alloc_status _mem_buddy_carve(pool_mgr_pt pool_mgr);
+static node_pt _mem_buddy_alloc(pool_mgr_pt pool_mgr, size_t size);
+static alloc_status _mem_buddy_free(pool_mgr_pt pool_mgr, node_pt node);
+static alloc_pt _mem_obj_alloc(pool_mgr_pt pool_mgr, size_t size);
+static unsigned _mem_obj_slot(pool_mgr_pt pool_mgr, alloc_pt alloc);
+static alloc_status _mem_obj_free(pool_mgr_pt pool_mgr, alloc_pt alloc);
+static alloc_pt _mem_slab_alloc(pool_mgr_pt pool_mgr, size_t size);
+static slab_pt _mem_slab_new(pool_mgr_pt pool_mgr, unsigned cls);
+static unsigned _mem_slab_rank(pool_mgr_pt pool_mgr, uintptr_t addr);
+static slab_pt _mem_slab_of(pool_mgr_pt pool_mgr, alloc_pt alloc);
+static alloc_status _mem_slab_free(pool_mgr_pt pool_mgr, slab_pt slab, alloc_pt alloc);
+static void _mem_slab_destroy(pool_mgr_pt pool_mgr, slab_pt slab);
+static void _mem_slab_free_all(pool_mgr_pt pool_mgr);
+static size_t _mem_arena_span(size_t size);
+static alloc_pt _mem_arena_alloc(pool_mgr_pt pool_mgr, size_t size, size_t align);
+static alloc_status _mem_arena_resize(pool_mgr_pt pool_mgr, alloc_pt alloc, size_t size);
 
 
 /* Definitions of user-facing functions */
@@ -120,6 +277,10 @@ alloc_status mem_free() {
 }
 
 pool_pt mem_pool_open(size_t size, alloc_policy policy) {
+    return mem_pool_open_ex(size, policy, 0);
+}
+
+pool_pt mem_pool_open_ex(size_t size, alloc_policy policy, unsigned flags) {
 
     // make sure there the pool store is allocated
     //assert(pool_store);
@@ -128,6 +289,19 @@ pool_pt mem_pool_open(size_t size, alloc_policy policy) {
 
     }
 
+    // fixed-size pools are opened with mem_obj_pool_open
+    if (policy == FIXED_SIZE) {
+        return NULL;
+    }
+
+    // check the options (buddy pools already round small requests to blocks,
+    // and an arena is cheaper than slabs; neither can have its blocks or
+    // records spread over extents)
+    if ((flags & ~(POOL_SMALL_SLABS | POOL_GROWABLE | POOL_HUGE_PAGES | POOL_PREFAULT)) != 0 ||
+        ((flags & (POOL_SMALL_SLABS | POOL_GROWABLE)) != 0 && (policy == BUDDY || policy == ARENA))) {
+        return NULL;
+    }
+
     // expand the pool store, if necessary
     if (((float) pool_store_size / pool_store_capacity) > MEM_POOL_STORE_FILL_FACTOR) {
         alloc_status resize = _mem_resize_pool_store();
@@ -136,43 +310,71 @@ pool_pt mem_pool_open(size_t size, alloc_policy policy) {
         }
     }
 
-    // allocate a new mem pool mgr
-    pool_mgr_pt mgr = (pool_mgr_pt) malloc(sizeof(pool_mgr_t));
+    // allocate a new mem pool mgr, zeroed so an arena has no node heap or gap index
+    pool_mgr_pt mgr = (pool_mgr_pt) calloc(1, sizeof(pool_mgr_t));
 
     // check success, on error return null
     if(mgr == NULL){
         return NULL;
     }
 
-    // allocate a new memory pool
-    mgr->pool.mem = (char *) malloc(size);
-
+    // allocate (map) a new memory pool, as the options say
     // check success, on error deallocate mgr and return null
-    if(mgr->pool.mem == NULL){
-        free(mgr->pool.mem);
+    mgr->flags = flags;
+    if(_mem_map_pool(mgr, size) != ALLOC_OK){
+        free(mgr);
         return NULL;
     }
 
-    // allocate a new node heap
-    mgr->node_heap = (node_pt) calloc(MEM_NODE_HEAP_INIT_CAPACITY, sizeof(node_t));
+    // populate it now, so the first allocations do not fault
+    if(flags & POOL_PREFAULT){
+        _mem_prefault(mgr, mgr->pool.mem, size);
+    }
+
+    // an arena only needs its bump pointer
+    if(policy == ARENA){
+        mgr->pool.policy = ARENA;
+        mgr->pool.total_size = size;
+        mgr->pool.num_gaps = 1;
+        mgr->arena_top = mgr->pool.mem;
+        mgr->arena_mark = mgr->pool.mem;
+
+        //   link pool mgr to pool store
+        int i = 0;
+        while (pool_store[i] != NULL) {
+            ++i;
+        }
+        pool_store[i] = mgr; // inserting the new manager
+        ++pool_store_size; //incrementing the size of the pool store
+
+        return (pool_pt) mgr;
+    }
+
+    // allocate a new node heap (its first chunk)
+    mgr->node_dir = NULL;
+    mgr->node_dir_size = 0;
+    mgr->node_dir_capacity = 0;
+    mgr->node_last = NULL;
+    mgr->total_nodes = 0;
+    mgr->node_free = NULL;
+    mgr->node_top = 0;
 
     // check success, on error deallocate mgr/pool and return null
-    if(mgr->node_heap == NULL){
-        free(mgr->pool.mem);
+    if(_mem_expand_node_heap(mgr) != ALLOC_OK){
+        _mem_unmap_pool(mgr);
+        _mem_free_node_heap(mgr);
         free(mgr);
         return NULL;
     }
+    mgr->node_heap = mgr->node_last;
 
     // allocate a new gap index
     mgr->gap_ix = (gap_pt) calloc(MEM_GAP_IX_INIT_CAPACITY, sizeof(gap_t));
-    for(int i = 0; i < MEM_GAP_IX_INIT_CAPACITY; ++i){
-        mgr->gap_ix[i].size = 0;
-    }
 
     // check success, on error deallocate mgr/pool/heap and return null
     if(mgr->gap_ix == NULL){
-        free(mgr->pool.mem);
-        free(mgr->node_heap);
+        _mem_unmap_pool(mgr);
+        _mem_free_node_heap(mgr);
         free(mgr);
         return NULL;
     }
@@ -187,20 +389,107 @@ pool_pt mem_pool_open(size_t size, alloc_policy policy) {
     mgr->node_heap[0].alloc_record.mem = mgr->pool.mem;
     mgr->node_heap[0].alloc_record.size = size;
 
-    // initialize top node of gap index
-    mgr->gap_ix[0].size = mgr->node_heap->alloc_record.size;
-    mgr->gap_ix[0].node = mgr->node_heap;
-    mgr->gap_ix_capacity = MEM_GAP_IX_INIT_CAPACITY;
-
     // initialize pool mgr
     mgr->pool.alloc_size = 0;
     mgr->pool.total_size = size;
     mgr->pool.num_allocs = 0;
-    mgr->pool.num_gaps = 1;
+    mgr->pool.num_gaps = 0;
     mgr->pool.policy = policy;
-    mgr->total_nodes = MEM_NODE_HEAP_INIT_CAPACITY;
     mgr->used_nodes = 1;
+    mgr->node_top = 1;
+    mgr->gap_ix_capacity = MEM_GAP_IX_INIT_CAPACITY;
+    _mem_clear_gap_ix(mgr);
+    mgr->rover = mgr->pool.mem;
+    mgr->obj_size = 0;
+    mgr->obj_count = 0;
+    mgr->obj_rec = NULL;
+    mgr->obj_free = NULL;
+    mgr->obj_free_top = 0;
+    for(int i = 0; i < MEM_NUM_SLAB_CLASSES; ++i){
+        mgr->slab_part[i] = NULL;
+    }
+    mgr->slab_dir = NULL;
+    mgr->slab_dir_size = 0;
+    mgr->slab_dir_capacity = 0;
+
+    // the whole pool is the top node of the gap index (sets num_gaps to 1)
+    _mem_add_to_gap_ix(mgr, size, mgr->node_heap);
+
+    // a buddy pool starts out as the largest aligned power-of-two blocks instead
+    if(policy == BUDDY && _mem_buddy_carve(mgr) != ALLOC_OK){
+        _mem_unmap_pool(mgr);
+        _mem_free_node_heap(mgr);
+        free(mgr->gap_ix);
+        free(mgr);
+        return NULL;
+    }
+
+
+    //   link pool mgr to pool store
+    int i = 0;
+    while (pool_store[i] != NULL) {
+        ++i;
+    }
+    pool_store[i] = mgr; // inserting the new manager
+    ++pool_store_size; //incrementing the size of the pool store
+
+    // return the address of the mgr, cast to (pool_pt)
+    return (pool_pt) mgr;
+}
+
+pool_pt mem_obj_pool_open(size_t obj_size, unsigned count) {
+
+    // make sure there the pool store is allocated
+    if (pool_store == NULL) {
+        return NULL;
+    }
+
+    // make sure the slots fit in a size_t
+    if (obj_size == 0 || count == 0 || count > (size_t) -1 / obj_size) {
+        return NULL;
+    }
+
+    // expand the pool store, if necessary
+    if (((float) pool_store_size / pool_store_capacity) > MEM_POOL_STORE_FILL_FACTOR) {
+        alloc_status resize = _mem_resize_pool_store();
+        if(resize != ALLOC_OK){
+            return NULL;
+        }
+    }
+
+    // allocate a new mem pool mgr, zeroed so it has no node heap or gap index
+    pool_mgr_pt mgr = (pool_mgr_pt) calloc(1, sizeof(pool_mgr_t));
+    if(mgr == NULL){
+        return NULL;
+    }
+
+    // allocate the memory pool, the slot records and the free slot stack
+    _mem_map_pool(mgr, obj_size * count);
+    mgr->obj_rec = (alloc_pt) calloc(count, sizeof(alloc_t));
+    mgr->obj_free = (unsigned *) malloc(count * sizeof(unsigned));
+    if(mgr->pool.mem == NULL || mgr->obj_rec == NULL || mgr->obj_free == NULL){
+        _mem_unmap_pool(mgr);
+        free(mgr->obj_rec);
+        free(mgr->obj_free);
+        free(mgr);
+        return NULL;
+    }
+
+    // every slot starts out free, the lowest address on top of the stack
+    for(unsigned u = 0; u < count; ++u){
+        mgr->obj_rec[u].mem = mgr->pool.mem + (size_t) u * obj_size;
+        mgr->obj_free[u] = count - 1 - u;
+    }
+    mgr->obj_size = obj_size;
+    mgr->obj_count = count;
+    mgr->obj_free_top = count;
 
+    // initialize pool mgr
+    mgr->pool.policy = FIXED_SIZE;
+    mgr->pool.total_size = obj_size * count;
+    mgr->pool.alloc_size = 0;
+    mgr->pool.num_allocs = 0;
+    mgr->pool.num_gaps = count;
 
     //   link pool mgr to pool store
     int i = 0;
@@ -229,24 +518,38 @@ alloc_status mem_pool_close(pool_pt pool) {
    // if(manager->pool.num_gaps != 1) {
        // return ALLOC_NOT_FREED;
    // }
-    if(manager->used_nodes > 1){
+    // check for zero allocations (an arena drops them all at once)
+    if(manager-> pool.num_allocs != 0 && manager->pool.policy != ARENA) {
         return ALLOC_NOT_FREED;
     }
 
-    // check for zero allocations
-    if(manager-> pool.num_allocs != 0) {
+    // the slabs are all empty now, so their pages go back to the gaps
+    _mem_slab_free_all(manager);
+
+    // (an empty buddy pool is still split into its initial blocks, and an
+    // empty growable pool is a gap per extent)
+    if(manager->pool.policy != BUDDY && manager->used_nodes > 1 + manager->ext_dir_size){
         return ALLOC_NOT_FREED;
     }
 
-    // free memory pool
-    free(manager->pool.mem);
+    // free memory pool, and the extents added to it
+    _mem_unmap_pool(manager);
+    for(unsigned e = 0; e < manager->ext_dir_size; ++e){
+        free(manager->ext_dir[e].mem);
+    }
+    free(manager->ext_dir);
 
     // free node heap
-    free(manager->node_heap);
+    _mem_free_node_heap(manager);
 
     // free gap index
     free(manager->gap_ix);
 
+    // free the slots of a fixed-size pool, and the marks of an arena
+    free(manager->obj_rec);
+    free(manager->obj_free);
+    free(manager->arena_marks);
+
     // find mgr in pool store and set to null
     int i = 0;
     while(pool_store[i] != manager){
@@ -262,266 +565,632 @@ alloc_status mem_pool_close(pool_pt pool) {
     return ALLOC_OK;
 }
 
-alloc_pt mem_new_alloc(pool_pt pool, size_t size) {
+alloc_status mem_pool_reset(pool_pt pool) {
 
     // get mgr from pool by casting the pointer to (pool_mgr_pt)
     pool_mgr_pt manager = (pool_mgr_pt) pool;
-    // alloc_pt newAlloc;
 
-    // check if any gaps, return null if none
-    if(manager->gap_ix[0].node == NULL){
-        return NULL;
+    if(manager == NULL) {
+        return ALLOC_FAIL;
     }
 
-    // expand heap node, if necessary, quit on error
-    if (((float) manager -> used_nodes / manager -> total_nodes) > MEM_NODE_HEAP_FILL_FACTOR) {
-        alloc_status resize = _mem_resize_node_heap(manager);
-        if (resize != ALLOC_OK) {
-            return NULL;
-        }
-    }
+    // the records live in the pool, so dropping them is moving the top back
+    if(manager->pool.policy == ARENA) {
+        manager->arena_top = manager->pool.mem;
+        manager->arena_mark = manager->pool.mem;
+        manager->arena_depth = 0;
+        manager->pool.alloc_size = 0;
+        manager->pool.num_allocs = 0;
+        manager->pool.num_gaps = 1;
 
-    // check used nodes fewer than total nodes, quit on error
-    if (manager -> used_nodes >= manager -> total_nodes) {
-        return NULL;
+        return ALLOC_OK;
     }
 
-    // get a node for allocation:
-    node_pt new_node;
-    int i = 0;
-
-    // if FIRST_FIT, then find the first sufficient node in the node heap
-    if(manager -> pool.policy == FIRST_FIT) {
-        node_pt this_node = manager -> node_heap;
-        while ((manager -> node_heap[i].allocated != 0) || (manager -> node_heap[i].alloc_record.size < size) && i < manager -> total_nodes) {
-            ++i;
-        }
-
-        if ( i == manager -> total_nodes) {
-            return NULL;
+    // every slot goes back on the free stack, the lowest address on top
+    if(manager->pool.policy == FIXED_SIZE) {
+        for(unsigned u = 0; u < manager->obj_count; ++u){
+            manager->obj_rec[u].size = 0;
+            manager->obj_free[u] = manager->obj_count - 1 - u;
         }
+        manager->obj_free_top = manager->obj_count;
+        manager->pool.alloc_size = 0;
+        manager->pool.num_allocs = 0;
+        manager->pool.num_gaps = manager->obj_count;
 
-        new_node = &manager -> node_heap[i];
+        return ALLOC_OK;
     }
 
-        // if BEST_FIT, then find the first sufficient node in the gap index
-    else if (manager -> pool.policy == BEST_FIT) {
-        if (manager ->pool.num_gaps > 0) {
-            while (i < manager -> pool.num_gaps && manager -> gap_ix[i+1].size >= size) {
-                if (manager -> gap_ix[i].size == size ) {
-                    break;
-                }
-                ++i;
-            }
-        } else {
-            return NULL;
-        }
-
-        // check if node found
-        new_node = manager -> gap_ix[i].node;
+    // the slab pages go with the rest of the pool, only their records are freed
+    for(unsigned d = 0; d < manager->slab_dir_size; ++d){
+        free(manager->slab_dir[d]);
     }
-
-    // update metadata (num_allocs, alloc_size)
-    manager -> pool.num_allocs++;
-    manager -> pool.alloc_size += size;
-
-    // calculate the size of the remaining gap, if any
-    // calculating the size left of one node
-    int size_of_gap = 0;
-    if(new_node -> alloc_record.size - size > 0) {
-        size_of_gap = new_node -> alloc_record.size - size;
+    manager->slab_dir_size = 0;
+    for(int i = 0; i < MEM_NUM_SLAB_CLASSES; ++i){
+        manager->slab_part[i] = NULL;
     }
 
-    // remove node from gap index
-    if(_mem_remove_from_gap_ix(manager,size,new_node) != ALLOC_OK){
-        return NULL;
+    // empty the node heap and the gap index, keeping their memory
+    _mem_clear_node_heap(manager);
+    _mem_clear_gap_ix(manager);
+
+    //   the top node of the node heap is the whole pool again
+    manager->node_heap[0].used = 1;
+    manager->node_heap[0].alloc_record.mem = manager->pool.mem;
+    manager->node_heap[0].alloc_record.size = manager->pool.total_size - _mem_ext_total(manager);
+    manager->used_nodes = 1;
+
+    manager->pool.alloc_size = 0;
+    manager->pool.num_allocs = 0;
+    manager->pool.num_gaps = 0;
+    manager->rover = manager->pool.mem;
+
+    // the whole pool is the only gap, as when it was opened (the gap index
+    // has room for it, and a buddy pool has the nodes for its blocks)
+    _mem_add_to_gap_ix(manager, manager->node_heap[0].alloc_record.size, manager->node_heap);
+    if(manager->pool.policy == BUDDY) {
+        return _mem_buddy_carve(manager);
     }
 
-    // convert gap_node to an allocation node of given size
-    new_node -> allocated = 1;
-    new_node -> used = 1;
-    new_node -> alloc_record.size = size;
+    // and each extent of a growable pool is a gap after it (the node heap
+    // had a node for each)
+    node_pt last = manager->node_heap;
+    for(unsigned e = 0; e < manager->ext_dir_size; ++e){
+        node_pt node = _mem_get_unused_node(manager);
+        node->used = 1;
+        node->alloc_record.mem = manager->ext_dir[e].mem;
+        node->alloc_record.size = manager->ext_dir[e].size;
+        node->prev = last;
+        last->next = node;
+        last = node;
+        _mem_add_to_gap_ix(manager, node->alloc_record.size, node);
+    }
 
+    return ALLOC_OK;
+}
 
-    // adjust node heap:
-    //   if remaining gap, need a new node
-    if (size_of_gap > 0) {
-        int j = 0;
+pool_mark_t mem_pool_mark(pool_pt pool) {
 
-        //   find an unused one in the node heap
-        while (manager -> node_heap[j].used != 0) { // change .used to .allocated
-            ++j;
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt manager = (pool_mgr_pt) pool;
+    pool_mark_t mark = { 0, 0, 0, 0, 0 };
+
+    // only an arena has a top to come back to
+    if(manager != NULL && manager->pool.policy == ARENA) {
+        // push the mark, expanding the stack if necessary (a mark that
+        // cannot be pushed has depth 0, which no rollback takes)
+        if(manager->arena_depth == manager->arena_marks_capacity) {
+            unsigned capacity = (manager->arena_marks_capacity == 0) ? MEM_ARENA_MARKS_INIT_CAPACITY
+                                : manager->arena_marks_capacity * MEM_ARENA_MARKS_EXPAND_FACTOR;
+            size_t *marks = (size_t *) realloc(manager->arena_marks, capacity * sizeof(size_t));
+            if(marks == NULL) {
+                return mark;
+            }
+            manager->arena_marks = marks;
+            manager->arena_marks_capacity = capacity;
         }
+        mark.seq = manager->arena_seq++;
+        manager->arena_marks[manager->arena_depth++] = mark.seq;
+        mark.depth = manager->arena_depth;
+
+        mark.top = (size_t) (manager->arena_top - manager->pool.mem);
+        mark.alloc_size = manager->pool.alloc_size;
+        mark.num_allocs = manager->pool.num_allocs;
+        manager->arena_mark = manager->arena_top;
+    }
+    return mark;
+}
 
-        node_pt new_gap_created = &manager -> node_heap[j];
+alloc_status mem_pool_rollback(pool_pt pool, pool_mark_t mark) {
 
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt manager = (pool_mgr_pt) pool;
 
-        //   make sure one was found
-        if (new_gap_created != NULL) {
+    // only an arena can roll back
+    if(manager == NULL || manager->pool.policy != ARENA) {
+        return ALLOC_FAIL;
+    }
 
-            //   initialize it to a gap node
-            new_gap_created -> used = 1;
-            new_gap_created -> allocated = 0;
-            new_gap_created -> alloc_record.size = size_of_gap;
-        }
+    // a mark no longer on the stack has been rolled back or reset past
+    // already, even if the arena has grown above it again
+    if(mark.depth == 0 || mark.depth > manager->arena_depth ||
+       manager->arena_marks[mark.depth - 1] != mark.seq) {
+        return ALLOC_FAIL;
+    }
 
-        //   update metadata (used_nodes)
-        manager -> used_nodes++;
+    // dropping the allocations made since the mark is moving the top back;
+    // the mark stays on the stack, and the marks after it come off
+    manager->arena_depth = mark.depth;
+    manager->arena_top = manager->pool.mem + mark.top;
+    manager->arena_mark = manager->arena_top;
+    manager->pool.alloc_size = mark.alloc_size;
+    manager->pool.num_allocs = mark.num_allocs;
+    manager->pool.num_gaps = (mark.top < manager->pool.total_size);
 
-        // update linked list (new node right after the node for allocation)
-        new_gap_created -> next = new_node -> next;
+    return ALLOC_OK;
+}
 
-        if(new_node -> next != NULL) {
-            new_node -> next -> prev = new_gap_created;
-        }
+alloc_status mem_pool_resize(pool_pt pool, size_t new_size) {
 
-        new_node -> next = new_gap_created;
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt manager = (pool_mgr_pt) pool;
 
-        new_gap_created -> prev = new_node;
+    // a buddy pool is split by its size, a fixed-size pool by its slots, and
+    // a growable pool's extents come after pool.mem
+    if(manager == NULL || new_size == 0 ||
+       manager->pool.policy == BUDDY || manager->pool.policy == FIXED_SIZE ||
+       (manager->flags & POOL_GROWABLE)) {
+        return ALLOC_FAIL;
+    }
+    size_t size = manager->pool.total_size;
+    if(new_size == size) {
+        return ALLOC_OK;
+    }
 
-        // add to gap index
-        _mem_add_to_gap_ix(manager, size_of_gap, new_gap_created);
+    // an arena can give back or take in the space above its top
+    if(manager->pool.policy == ARENA) {
+        if(new_size < (size_t) (manager->arena_top - manager->pool.mem) ||
+           _mem_remap_pool(manager, size, new_size) != ALLOC_OK) {
+            return ALLOC_FAIL;
+        }
+        manager->pool.total_size = new_size;
+        manager->pool.num_gaps = (manager->arena_top < manager->pool.mem + new_size);
+        return ALLOC_OK;
+    }
 
+    // find the last node, the one that ends at the end of the pool
+    node_pt last = manager->node_heap;
+    while(last->next != NULL) {
+        last = last->next;
     }
 
-    // return allocation record by casting the node to (alloc_pt)
-    return (alloc_pt) new_node;
+    if(new_size < size) {
+        // only a gap at the end can be cut off
+        if(last->allocated != 0 || last->alloc_record.size < size - new_size ||
+           _mem_remap_pool(manager, size, new_size) != ALLOC_OK) {
+            return ALLOC_FAIL;
+        }
+        _mem_remove_from_gap_ix(manager, last->alloc_record.size, last);
+        if(last->alloc_record.size == size - new_size) {
+            //   the gap is gone, unlink its node
+            last->prev->next = NULL;
+            _mem_put_unused_node(manager, last);
+        } else {
+            last->alloc_record.size -= size - new_size;
+            _mem_add_to_gap_ix(manager, last->alloc_record.size, last);
+        }
+        if(manager->rover > manager->pool.mem + new_size) {
+            manager->rover = manager->pool.mem + new_size;
+        }
+    } else {
+        // the new end is a gap of its own, or makes the gap at the end longer
+        if(_mem_reserve_nodes(manager, 1) != ALLOC_OK ||
+           _mem_remap_pool(manager, size, new_size) != ALLOC_OK) {
+            return ALLOC_FAIL;
+        }
+        if(last->allocated == 0) {
+            _mem_remove_from_gap_ix(manager, last->alloc_record.size, last);
+            last->alloc_record.size += new_size - size;
+        } else {
+            node_pt gap = _mem_get_unused_node(manager);
+            gap->used = 1;
+            gap->allocated = 0;
+            gap->alloc_record.mem = manager->pool.mem + size;
+            gap->alloc_record.size = new_size - size;
+            gap->prev = last;
+            last->next = gap;
+            last = gap;
+        }
+        _mem_add_to_gap_ix(manager, last->alloc_record.size, last);
 
-    //   check if successful
+        // a rover at the old end is inside the gap now, so it moves back to its start
+        if(manager->rover > last->alloc_record.mem) {
+            manager->rover = last->alloc_record.mem;
+        }
+    }
+    manager->pool.total_size = new_size;
+
+    return ALLOC_OK;
 }
 
-alloc_status mem_del_alloc(pool_pt pool, alloc_pt alloc) {
+alloc_pt mem_new_alloc(pool_pt pool, size_t size) {
+
     // get mgr from pool by casting the pointer to (pool_mgr_pt)
     pool_mgr_pt manager = (pool_mgr_pt) pool;
+    // alloc_pt newAlloc;
 
-    node_pt delete_node;
+    // fixed-size pools hand out whole slots
+    if(manager -> pool.policy == FIXED_SIZE) {
+        return _mem_obj_alloc(manager, size);
+    }
 
-    // get node from alloc by casting the pointer to (node_pt)
-    node_pt node = (node_pt) alloc;
+    // an arena bumps its top
+    if(manager -> pool.policy == ARENA) {
+        return _mem_arena_alloc(manager, size, 1);
+    }
 
-    // find the node in the node heap
-    for(int i = 0; i < manager -> total_nodes; ++i) {
-        if (node == &manager -> node_heap[i]) {
-            // this is node-to-delete
-            delete_node = &manager -> node_heap[i];
-            break;
+    // small requests share slab pages, if the pool has them
+    if((manager -> flags & POOL_SMALL_SLABS) &&
+       size <= MEM_SLAB_CLASS_SIZE[MEM_NUM_SLAB_CLASSES - 1]) {
+        alloc_pt alloc = _mem_slab_alloc(manager, size);
+        if(alloc != NULL) {
+            return alloc;
         }
+        // no room for a new slab page, so try a node of its own
     }
 
+    // check if any gaps, return null if none (and the pool cannot grow)
+    if(manager->pool.num_gaps == 0 && !(manager->flags & POOL_GROWABLE)){
+        return NULL;
+    }
 
-    // make sure it's found
-    if(delete_node == NULL) {
-        return ALLOC_NOT_FREED;
+    // buddy pools split and merge blocks by their own rules
+    if(manager -> pool.policy == BUDDY) {
+        return (alloc_pt) _mem_buddy_alloc(manager, size);
     }
 
-    // convert to gap node
-    delete_node -> allocated = 0;
+    // carve the allocation out of a gap
+    node_pt new_node = _mem_carve_node(manager, size, 1);
+    if (new_node == NULL) {
+        return NULL;
+    }
 
     // update metadata (num_allocs, alloc_size)
-    manager -> pool.num_allocs--;
-    manager -> pool.alloc_size -= delete_node -> alloc_record.size;
-
-
-    // if the next node in the list is also a gap, merge into node-to-delete
-    node_pt node_to_merge = NULL;
-    if (delete_node -> next != NULL && delete_node -> next -> used == 1 && delete_node -> next -> allocated == 0 ) {
+    manager -> pool.num_allocs++;
+    manager -> pool.alloc_size += size;
 
-        node_to_merge = delete_node->next;
+    // return allocation record by casting the node to (alloc_pt)
+    return (alloc_pt) new_node;
+}
 
-        //   remove the next node from gap index
-        _mem_remove_from_gap_ix(manager, node_to_merge->alloc_record.size, node_to_merge);
+alloc_pt mem_new_alloc_aligned(pool_pt pool, size_t size, size_t align) {
 
-        //   check success
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt manager = (pool_mgr_pt) pool;
 
-        //   add the size to the node-to-delete
-        delete_node->alloc_record.size = delete_node->alloc_record.size + delete_node->next->alloc_record.size;
+    // the alignment has to be a power of two
+    if(align == 0 || (align & (align - 1)) != 0) {
+        return NULL;
+    }
 
-        //   update node as unused
-        node_to_merge->used = 0;
+    // the slots of a fixed-size pool are either all aligned or not
+    if(manager -> pool.policy == FIXED_SIZE) {
+        if(_mem_align_pad(manager -> pool.mem, align) != 0 || manager -> obj_size % align != 0) {
+            return NULL;
+        }
+        return _mem_obj_alloc(manager, size);
+    }
 
-        //   update metadata (used nodes)
-        manager->used_nodes--;
+    // an arena pads its top
+    if(manager -> pool.policy == ARENA) {
+        return _mem_arena_alloc(manager, size, align);
+    }
 
-        //   update linked list:
+    // check if any gaps, return null if none (and the pool cannot grow)
+    if(manager -> pool.num_gaps == 0 && !(manager -> flags & POOL_GROWABLE)) {
+        return NULL;
+    }
 
-        if (node_to_merge->next) {
-            node_to_merge->next->prev = delete_node;
-            delete_node->next = node_to_merge->next;
-        } else {
-            delete_node->next = NULL;
+    // a buddy block is aligned to its size within the pool
+    if(manager -> pool.policy == BUDDY) {
+        if(_mem_align_pad(manager -> pool.mem, align) != 0) {
+            return NULL;
         }
-        node_to_merge->next = NULL;
-        node_to_merge->prev = NULL;
-        node_to_merge->alloc_record.mem = NULL;
-        node_to_merge->alloc_record.size = 0;
-    };
-
-    // this merged node-to-delete might need to be added to the gap index
-    _mem_add_to_gap_ix(manager, delete_node ->alloc_record.size, delete_node);
-
-    // but one more thing to check...
-    // if the previous node in the list is also a gap, merge into previous!
-    node_pt previous_node;
+        return (alloc_pt) _mem_buddy_alloc(manager, (size > align) ? size : align);
+    }
 
-    if(delete_node -> prev != NULL && delete_node -> prev -> allocated == 0 && delete_node -> prev -> used == 1) {
-        previous_node = delete_node->prev;
+    // carve the allocation past any padding (slab pages are not aligned,
+    // so aligned requests never take slab objects)
+    node_pt new_node = _mem_carve_node(manager, size, align);
+    if(new_node == NULL) {
+        return NULL;
+    }
 
-        //   remove the previous node from gap index
-        _mem_remove_from_gap_ix(manager, previous_node->alloc_record.size, previous_node);
-        _mem_remove_from_gap_ix(manager, delete_node->alloc_record.size, delete_node);
+    // update metadata (num_allocs, alloc_size)
+    manager -> pool.num_allocs++;
+    manager -> pool.alloc_size += size;
 
-        //   check success
-        //   add the size of node-to-delete to the previous
-        previous_node->alloc_record.size = delete_node->alloc_record.size + delete_node->prev->alloc_record.size;
+    // return allocation record by casting the node to (alloc_pt)
+    return (alloc_pt) new_node;
+}
 
-        // set the char * mem to NULL and updated the allocated record size
-        delete_node->alloc_record.mem = NULL;
-        delete_node->alloc_record.size = 0;
+alloc_pt mem_realloc_alloc(pool_pt pool, alloc_pt alloc, size_t new_size) {
 
-        //   update node-to-delete as unused
-        delete_node->used = 0;
-        delete_node->allocated = 0;
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt manager = (pool_mgr_pt) pool;
 
-        //   update metadata (used_nodes)
-        manager->used_nodes--;
+    // like realloc(), no allocation yet means a new one
+    if(alloc == NULL) {
+        return mem_new_alloc(pool, new_size);
+    }
 
-        //   update linked list
+    // a slot cannot grow or move to a bigger one
+    if(manager -> pool.policy == FIXED_SIZE) {
+        if(_mem_obj_slot(manager, alloc) == manager -> obj_count || new_size > manager -> obj_size) {
+            return NULL;
+        }
+        return alloc;
+    }
 
-        if (delete_node->next) {
-            previous_node->next = delete_node->next;
-            delete_node->next->prev = previous_node;
-        } else {
-            previous_node->next = NULL;
+    // try to change the size where the allocation is
+    if(manager -> pool.policy == ARENA) {
+        // only the allocation at the top can
+        if(_mem_arena_resize(manager, alloc, new_size) == ALLOC_OK) {
+            return alloc;
         }
-        delete_node->next = NULL;
-        delete_node->prev = NULL;
+    } else {
+        slab_pt slab = (manager -> flags & POOL_SMALL_SLABS) ? _mem_slab_of(manager, alloc) : NULL;
+        if(slab != NULL) {
+            // a small object keeps its place while it fits it, and its size
+            // stays the class size, as when it was allocated
+            if(alloc -> size == 0) {
+                return NULL;
+            }
+            if(new_size <= MEM_SLAB_CLASS_SIZE[slab -> cls]) {
+                return alloc;
+            }
+        } else {
+            node_pt node = _mem_node_of(manager, alloc);
+            if(node == NULL) {
+                return NULL;
+            }
 
-        //   change the node to add to the previous node!
-        // add the resulting node to the gap index
+            // a buddy block keeps its place, and its block size as its size,
+            // while it is the right order; any other node shrinks or grows
+            // into the gap after it
+            if(manager -> pool.policy == BUDDY) {
+                if(_mem_buddy_order(new_size) == _mem_buddy_order(alloc -> size)) {
+                    return alloc;
+                }
+            } else if(_mem_resize_node(manager, node, new_size) == ALLOC_OK) {
+                return alloc;
+            }
+        }
+    }
 
-        _mem_add_to_gap_ix(manager, previous_node->alloc_record.size, previous_node);
-        // check success
-    };
+    // otherwise move it (an arena keeps the old copy until it is reset)
+    alloc_pt moved = mem_new_alloc(pool, new_size);
+    if(moved == NULL) {
+        return NULL;
+    }
+    memcpy(moved -> mem, alloc -> mem, (alloc -> size < new_size) ? alloc -> size : new_size);
+    mem_del_alloc(pool, alloc);
 
-    return ALLOC_OK;
+    return moved;
 }
 
-void mem_inspect_pool(pool_pt pool, pool_segment_pt *segments, unsigned *num_segments) {
-    // get the mgr from the pool
-    pool_mgr_pt pool_manager = (pool_mgr_pt) pool;
+alloc_status mem_new_alloc_batch(pool_pt pool, const size_t *sizes, size_t n, alloc_pt *out) {
 
-    // allocate the segments array with size == used_nodes
-    pool_segment_pt segs = (pool_segment_pt) calloc(pool_manager->used_nodes, sizeof(pool_segment_t));
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt manager = (pool_mgr_pt) pool;
+    alloc_status status = ALLOC_OK;
 
-    // check successful
-    assert(segs);
-    node_pt current = pool_manager->node_heap;
+    if(manager == NULL || (n > 0 && (sizes == NULL || out == NULL))) {
+        return ALLOC_FAIL;
+    }
+    for(size_t i = 0; i < n; ++i) {
+        out[i] = NULL;
+    }
+
+    // an arena bumps its top for each one, and gives them all back at once
+    if(manager -> pool.policy == ARENA) {
+        pool_mark_t mark = mem_pool_mark(pool);
+        for(size_t i = 0; i < n; ++i) {
+            out[i] = _mem_arena_alloc(manager, sizes[i], 1);
+            if(out[i] == NULL) {
+                mem_pool_rollback(pool, mark);
+                for(size_t j = 0; j < i; ++j) {
+                    out[j] = NULL;
+                }
+                return ALLOC_FAIL;
+            }
+        }
+        return ALLOC_OK;
+    }
+
+    // slots and buddy blocks have no gaps to share, so take them one by one
+    if(manager -> pool.policy == FIXED_SIZE || manager -> pool.policy == BUDDY) {
+        for(size_t i = 0; i < n && status == ALLOC_OK; ++i) {
+            out[i] = mem_new_alloc(pool, sizes[i]);
+            status = (out[i] == NULL) ? ALLOC_FAIL : ALLOC_OK;
+        }
+    } else {
+        // small requests go to their slabs first, the rest are carved together
+        if(manager -> flags & POOL_SMALL_SLABS) {
+            for(size_t i = 0; i < n; ++i) {
+                if(sizes[i] <= MEM_SLAB_CLASS_SIZE[MEM_NUM_SLAB_CLASSES - 1]) {
+                    out[i] = _mem_slab_alloc(manager, sizes[i]);
+                }
+            }
+        }
+        status = _mem_carve_batch(manager, sizes, n, out);
+    }
+
+    // all or nothing: give back what was allocated before the failure
+    if(status != ALLOC_OK) {
+        for(size_t i = 0; i < n; ++i) {
+            if(out[i] != NULL) {
+                mem_del_alloc(pool, out[i]);
+                out[i] = NULL;
+            }
+        }
+    }
+    return status;
+}
+
+alloc_status mem_del_alloc(pool_pt pool, alloc_pt alloc) {
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt manager = (pool_mgr_pt) pool;
+
+    // fixed-size pools take back whole slots
+    if(manager -> pool.policy == FIXED_SIZE) {
+        return _mem_obj_free(manager, alloc);
+    }
+
+    // an arena only lets go of everything at once, with mem_pool_reset
+    if(manager -> pool.policy == ARENA) {
+        return ALLOC_NOT_FREED;
+    }
+
+    // small objects go back to their slab
+    if(manager -> flags & POOL_SMALL_SLABS) {
+        slab_pt slab = _mem_slab_of(manager, alloc);
+        if(slab != NULL) {
+            return _mem_slab_free(manager, slab, alloc);
+        }
+    }
+
+    // get node from alloc by casting the pointer to (node_pt)
+    node_pt delete_node = _mem_node_of(manager, alloc);
+
+    // make sure it's one of this pool's live allocations
+    if(delete_node == NULL) {
+        return ALLOC_NOT_FREED;
+    }
+
+    // convert to gap node
+    delete_node -> allocated = 0;
+
+    // update metadata (num_allocs, alloc_size)
+    manager -> pool.num_allocs--;
+    manager -> pool.alloc_size -= delete_node -> alloc_record.size;
+
+    // buddy blocks only merge with their buddies
+    if (manager -> pool.policy == BUDDY) {
+        return _mem_buddy_free(manager, delete_node);
+    }
+
+
+    // merge the new gap with its neighbors
+    return _mem_release_node(manager, delete_node);
+}
+
+alloc_status mem_del_alloc_batch(pool_pt pool, alloc_pt *allocs, size_t n) {
+
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt manager = (pool_mgr_pt) pool;
+    alloc_status status = ALLOC_OK;
+
+    if(manager == NULL || (n > 0 && allocs == NULL)) {
+        return ALLOC_FAIL;
+    }
+
+    // slots and buddy blocks merge by their own rules, so free them one by one,
+    // and so does a batch too big to sort
+    node_key_pt keys = NULL;
+    if(manager -> pool.policy != FIXED_SIZE && manager -> pool.policy != ARENA &&
+       manager -> pool.policy != BUDDY && n > 0 && n <= (size_t) -1 / (2 * sizeof(node_key_t))) {
+        keys = (node_key_pt) malloc(2 * n * sizeof(node_key_t));
+    }
+    if(keys == NULL) {
+        for(size_t i = 0; i < n; ++i) {
+            if(mem_del_alloc(pool, allocs[i]) != ALLOC_OK) {
+                status = ALLOC_NOT_FREED;
+            }
+        }
+        return status;
+    }
+
+    // the offsets are from the lowest extent (pool.mem if there are none)
+    uintptr_t lo = (uintptr_t) manager -> pool.mem;
+    uintptr_t hi = lo + manager -> pool.total_size;
+    for(unsigned e = 0; e < manager -> ext_dir_size; ++e) {
+        uintptr_t mem = (uintptr_t) manager -> ext_dir[e].mem;
+        lo = (mem < lo) ? mem : lo;
+        hi = (mem + manager -> ext_dir[e].size > hi) ? mem + manager -> ext_dir[e].size : hi;
+    }
+
+    // take the live allocations out of use, skipping anything else
+    // (a handle given twice is not live the second time); small objects
+    // wait at the end of the keys, by their index in allocs
+    size_t count = 0, num_objs = 0;
+    for(size_t i = 0; i < n; ++i) {
+        if((manager -> flags & POOL_SMALL_SLABS) && _mem_slab_of(manager, allocs[i]) != NULL) {
+            ++num_objs;
+            keys[n - num_objs].offset = i;
+            keys[n - num_objs].node = NULL;
+            continue;
+        }
+        node_pt node = _mem_node_of(manager, allocs[i]);
+        if(node == NULL) {
+            status = ALLOC_NOT_FREED;
+            continue;
+        }
+        node -> allocated = 0;
+        manager -> pool.num_allocs--;
+        manager -> pool.alloc_size -= node -> alloc_record.size;
+        keys[count].offset = (uintptr_t) node -> alloc_record.mem - lo;
+        keys[count].node = node;
+        ++count;
+    }
+
+    // merge them with each other and the gaps around them in address order
+    node_key_pt sorted = _mem_sort_node_keys(keys, keys + n, count, hi - lo);
+    _mem_release_batch(manager, sorted, count);
+
+    // only now that the gaps are indexed can an emptied slab give its page
+    // back, since its page merges with the gaps next to it
+    for(size_t j = 1; j <= num_objs; ++j) {
+        alloc_pt alloc = allocs[keys[n - j].offset];
+        slab_pt slab = _mem_slab_of(manager, alloc);
+        if(slab == NULL || _mem_slab_free(manager, slab, alloc) != ALLOC_OK) {
+            status = ALLOC_NOT_FREED;
+        }
+    }
+    free(keys);
+
+    return status;
+}
+
+void mem_inspect_pool(pool_pt pool, pool_segment_pt *segments, unsigned *num_segments) {
+    // get the mgr from the pool
+    pool_mgr_pt pool_manager = (pool_mgr_pt) pool;
+
+    // a fixed-size pool lists every slot as a segment
+    if(pool_manager->pool.policy == FIXED_SIZE){
+        pool_segment_pt segs = (pool_segment_pt) calloc(pool_manager->obj_count, sizeof(pool_segment_t));
+        assert(segs);
+        for(unsigned u = 0; u < pool_manager->obj_count; ++u){
+            segs[u].size = pool_manager->obj_size;
+            segs[u].allocated = (pool_manager->obj_rec[u].size != 0);
+        }
+        *segments = segs;
+        *num_segments = pool_manager->obj_count;
+        return;
+    }
+
+    // an arena lists its records, then the space above the top as one gap
+    if(pool_manager->pool.policy == ARENA){
+        pool_segment_pt segs = (pool_segment_pt) calloc(pool_manager->pool.num_allocs + 1, sizeof(pool_segment_t));
+        assert(segs);
+        unsigned num = 0;
+        for(char *rec = pool_manager->pool.mem; rec < pool_manager->arena_top; rec += _mem_arena_span(((alloc_pt) rec)->size)){
+            // a padding record goes with the allocation after it
+            segs[num].size += _mem_arena_span(((alloc_pt) rec)->size);
+            if(((alloc_pt) rec)->mem != NULL){
+                segs[num++].allocated = 1;
+            }
+        }
+        if(pool_manager->pool.num_gaps){
+            segs[num].size = pool_manager->pool.total_size - (pool_manager->arena_top - pool_manager->pool.mem);
+            segs[num++].allocated = 0;
+        }
+        *segments = segs;
+        *num_segments = num;
+        return;
+    }
+
+    // allocate the segments array with size == used_nodes
+    pool_segment_pt segs = (pool_segment_pt) calloc(pool_manager->used_nodes, sizeof(pool_segment_t));
+
+    // check successful
+    assert(segs);
+    node_pt current = pool_manager->node_heap;
 
     // loop through the node heap and the segments array
     for(int i = 0; i < pool_manager->used_nodes; i++){
         //    for each node, write the size and allocated in the segment
         segs[i].size = current->alloc_record.size;
-        segs[i].allocated = current->allocated;
+        segs[i].allocated = (current->allocated != 0);
         if(current->next != NULL) {
             current = current->next;
         }
@@ -553,6 +1222,9 @@ static alloc_status _mem_resize_pool_store() {
         }
         //double check that pool_store isnt NULL after realloc
         assert(pool_store);
+        //The new slots are not initialized by realloc, and open looks for a NULL one
+        memset(pool_store + pool_store_capacity, 0,
+               sizeof(pool_mgr_pt) * (expandFactor - pool_store_capacity));
         //Update capacity variable
         pool_store_capacity = expandFactor;
 
@@ -571,130 +1243,1727 @@ static alloc_status _mem_resize_node_heap(pool_mgr_pt pool_mgr_ptr) {
     //  "necessary" to resize when size/cap > 0.75
     if(((float)pool_mgr_ptr->used_nodes / (float)pool_mgr_ptr->total_nodes) > MEM_NODE_HEAP_FILL_FACTOR){
 
-        //Reallocate more nodes to the node_heap, by the size of the
-        //Perform the realloc straight to the node_heap pointer
-        pool_mgr_ptr->node_heap = (node_pt)realloc(pool_mgr_ptr->node_heap,
-                                                   MEM_NODE_HEAP_EXPAND_FACTOR * pool_mgr_ptr->total_nodes * sizeof(node_t));
-        //Check and see if the realloc failed
-        if (NULL == pool_mgr_ptr->node_heap){
+        return _mem_expand_node_heap(pool_mgr_ptr);
+    }
+
+    return ALLOC_OK;
+}
+
+// unconditionally grows the node heap by one chunk; nothing is copied, so
+// the nodes already handed out never move
+static alloc_status _mem_expand_node_heap(pool_mgr_pt pool_mgr_ptr) {
+
+    //Make room in the chunk directory (only chunk pointers are copied)
+    if (pool_mgr_ptr->node_dir_size == pool_mgr_ptr->node_dir_capacity) {
+        unsigned capacity = (pool_mgr_ptr->node_dir_capacity == 0) ?
+                            MEM_NODE_DIR_INIT_CAPACITY :
+                            MEM_NODE_DIR_EXPAND_FACTOR * pool_mgr_ptr->node_dir_capacity;
+        node_pt *dir = (node_pt *) realloc(pool_mgr_ptr->node_dir, capacity * sizeof(node_pt));
+        if (NULL == dir) {
 
             return ALLOC_FAIL;
         }
-        //Make sure to update the number of nodes!  This is a prop of the pool_mgr_t
-        pool_mgr_ptr->total_nodes *= MEM_NODE_HEAP_EXPAND_FACTOR;
+        pool_mgr_ptr->node_dir = dir;
+        pool_mgr_ptr->node_dir_capacity = capacity;
+    }
 
-        return ALLOC_OK;
+    //Allocate the new chunk, zeroed so its nodes are unused
+    node_pt chunk = (node_pt) calloc(MEM_NODE_CHUNK_CAPACITY, sizeof(node_t));
+    //Check and see if the calloc failed
+    if (NULL == chunk){
+
+        return ALLOC_FAIL;
+    }
+
+    //Nodes of the last chunk that were never used go on the free list
+    if (pool_mgr_ptr->node_last != NULL) {
+        while (pool_mgr_ptr->node_top < MEM_NODE_CHUNK_CAPACITY) {
+            node_pt node = &pool_mgr_ptr->node_last[pool_mgr_ptr->node_top++];
+            node->next = pool_mgr_ptr->node_free;
+            pool_mgr_ptr->node_free = node;
+        }
+    }
+
+    //Insert the chunk into the directory, keeping it sorted by address
+    unsigned i = pool_mgr_ptr->node_dir_size;
+    while (i > 0 && (uintptr_t) pool_mgr_ptr->node_dir[i - 1] > (uintptr_t) chunk) {
+        pool_mgr_ptr->node_dir[i] = pool_mgr_ptr->node_dir[i - 1];
+        --i;
     }
+    pool_mgr_ptr->node_dir[i] = chunk;
+    pool_mgr_ptr->node_dir_size++;
+
+    pool_mgr_ptr->node_last = chunk;
+    pool_mgr_ptr->node_top = 0;
+
+    //Make sure to update the number of nodes!  This is a prop of the pool_mgr_t
+    pool_mgr_ptr->total_nodes += MEM_NODE_CHUNK_CAPACITY;
 
     return ALLOC_OK;
 }
 
+// frees every chunk of the node heap and the directory
+static void _mem_free_node_heap(pool_mgr_pt pool_mgr) {
+    for (unsigned i = 0; i < pool_mgr->node_dir_size; ++i) {
+        free(pool_mgr->node_dir[i]);
+    }
+    free(pool_mgr->node_dir);
+    pool_mgr->node_dir = NULL;
+    pool_mgr->node_dir_size = 0;
+}
 
+#ifdef __linux__
+// the unit a pool is mapped and resized in
+static size_t _mem_map_granule(pool_mgr_pt pool_mgr) {
+    return (pool_mgr->flags & POOL_HUGE_PAGES) ? MEM_HUGE_PAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE);
+}
+#endif
+
+// the memory of a pool is mapped on Linux, followed by address space
+// reserved for mem_pool_resize to grow it in place, and comes from malloc
+// elsewhere; map_size is the size of both
+static alloc_status _mem_map_pool(pool_mgr_pt pool_mgr, size_t size) {
+#ifdef __linux__
+    size_t page = _mem_map_granule(pool_mgr);
+    if (size > (size_t) -1 - page) {
+        return ALLOC_FAIL;
+    }
+    size_t len = (size + page - 1) / page * page;
+    len = (len == 0) ? page : len;
+    int huge = (pool_mgr->flags & POOL_HUGE_PAGES) != 0;
+
+#ifdef MAP_HUGETLB
+    // pages from the huge page pool, if it has enough for the whole pool;
+    // they are set aside now, so there is no reserve
+    if (huge) {
+        void *mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            pool_mgr->pool.mem = (char *) mem;
+            pool_mgr->map_size = len;
+            return ALLOC_OK;
+        }
+    }
+#endif
+
+    // reserve the address space without committing memory, and make the
+    // pool's part of it usable; without room for a reserve, map just the pool
+    size_t slack = huge ? page : 0; // room to align the start to a huge page
+    size_t reserve = (len <= ((size_t) -1 - slack) / MEM_MAP_RESERVE_FACTOR) ? len * MEM_MAP_RESERVE_FACTOR : len;
+    void *mem = mmap(NULL, reserve + slack, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED) {
+        reserve = len;
+        mem = mmap(NULL, len + slack, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            return ALLOC_FAIL;
+        }
+    }
+    if (slack != 0) {
+        //   trim the mapping to the aligned start and the reserve after it
+        size_t head = (page - (uintptr_t) mem % page) % page;
+        if (head != 0) {
+            munmap(mem, head);
+        }
+        if (head != slack) {
+            munmap((char *) mem + head + reserve, slack - head);
+        }
+        mem = (char *) mem + head;
+    }
+    if (mprotect(mem, len, PROT_READ | PROT_WRITE) != 0) {
+        munmap(mem, reserve);
+        return ALLOC_FAIL;
+    }
 
-static alloc_status _mem_resize_gap_ix(pool_mgr_pt pool_mgr) {
+    // transparent huge pages for the pool and what it may grow into; this is
+    // advice, which a kernel without them ignores
+#ifdef MADV_HUGEPAGE
+    if (huge) {
+        madvise(mem, reserve, MADV_HUGEPAGE);
+    }
+#endif
+    pool_mgr->pool.mem = (char *) mem;
+    pool_mgr->map_size = reserve;
+#else
+    pool_mgr->pool.mem = (char *) malloc(size);
+    pool_mgr->map_size = size;
+#endif
+    return (pool_mgr->pool.mem == NULL) ? ALLOC_FAIL : ALLOC_OK;
+}
 
-    float expandFactor = (float)MEM_GAP_IX_EXPAND_FACTOR * (float)pool_mgr->gap_ix_capacity;
-    //Does gap_ix need to be resized?
-    if((((float)pool_mgr->pool.num_gaps)/(pool_mgr->gap_ix_capacity)) > MEM_GAP_IX_FILL_FACTOR){
-        //resize if needed
-        //Perform realloc to increase size of gap_ix
-        pool_mgr->gap_ix = realloc(pool_mgr->gap_ix, expandFactor * sizeof(gap_t));
-        //update metadata
-        //  Expand the gap_ix_capacity by the same factor as the realloc
-        pool_mgr->gap_ix_capacity *= MEM_GAP_IX_EXPAND_FACTOR;
-        //Check and make sure it worked
-        if(NULL == pool_mgr->gap_ix){
+static void _mem_unmap_pool(pool_mgr_pt pool_mgr) {
+#ifdef __linux__
+    if (pool_mgr->pool.mem != NULL) {
+        munmap(pool_mgr->pool.mem, pool_mgr->map_size);
+    }
+#else
+    free(pool_mgr->pool.mem);
+#endif
+    pool_mgr->pool.mem = NULL;
+}
 
-            return ALLOC_FAIL;
+// makes the pages of [mem, mem + len) present, as a write to each of them
+// would, and adds the time it took to pool.prefault_ns; the kernel does it
+// in one call where it can
+static void _mem_prefault(pool_mgr_pt pool_mgr, char *mem, size_t len) {
+    struct timespec start, end;
+#ifdef __linux__
+    clock_gettime(CLOCK_MONOTONIC, &start);
+#else
+    timespec_get(&start, TIME_UTC);
+#endif
+
+#if defined(__linux__) && defined(MADV_POPULATE_WRITE)
+    if (madvise(mem, len, MADV_POPULATE_WRITE) != 0)
+#endif
+    {
+        for (size_t offset = 0; offset < len; offset += MEM_PREFAULT_STRIDE) {
+            ((volatile char *) mem)[offset] = 0;
         }
+    }
+
+#ifdef __linux__
+    clock_gettime(CLOCK_MONOTONIC, &end);
+#else
+    timespec_get(&end, TIME_UTC);
+#endif
+    pool_mgr->pool.prefault_ns += (unsigned long long) ((end.tv_sec - start.tv_sec) * 1000000000LL +
+                                                        (end.tv_nsec - start.tv_nsec));
+}
+
+// resizes the memory of a pool without moving it: within the reserve, pages
+// are made usable or given back to it; past the reserve, the reserve grows
+// into the address space after it, which is rarely free, so a pool can in
+// practice grow to MEM_MAP_RESERVE_FACTOR times the size it was opened with
+static alloc_status _mem_remap_pool(pool_mgr_pt pool_mgr, size_t size, size_t new_size) {
+#ifdef __linux__
+    size_t page = _mem_map_granule(pool_mgr);
+    if (new_size > (size_t) -1 - page) {
+        return ALLOC_FAIL;
+    }
+    char *mem = pool_mgr->pool.mem;
+    size_t len = (size + page - 1) / page * page;
+    size_t new_len = (new_size + page - 1) / page * page;
+
+    if (new_len < len) {
+        // a fresh reserved mapping over the cut-off pages frees them
+        void *rest = mmap(mem + new_len, len - new_len, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        return (rest == MAP_FAILED) ? ALLOC_FAIL : ALLOC_OK;
+    }
+    if (new_len == len) {
         return ALLOC_OK;
     }
+    if (new_len > pool_mgr->map_size) {
+        // past the reserve, which is kept whatever happens, the address
+        // space right after it is taken too, if no other mapping has it
+        char *end = mem + pool_mgr->map_size;
+        size_t more = new_len - pool_mgr->map_size;
+#ifdef MAP_FIXED_NOREPLACE
+        void *rest = mmap(end, more, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+#else
+        void *rest = mmap(end, more, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+#endif
+        if (rest != (void *) end) {
+            //   (a kernel that does not know the flag takes it as a hint)
+            if (rest != MAP_FAILED) {
+                munmap(rest, more);
+            }
+            return ALLOC_FAIL;
+        }
+        pool_mgr->map_size = new_len;
+    }
+    if (mprotect(mem + len, new_len - len, PROT_READ | PROT_WRITE) != 0) {
+        return ALLOC_FAIL;
+    }
+    if (pool_mgr->flags & POOL_PREFAULT) {
+        _mem_prefault(pool_mgr, mem + len, new_len - len);
+    }
     return ALLOC_OK;
+#else
+    (void) pool_mgr;
+    (void) size;
+    (void) new_size;
+    return ALLOC_FAIL;
+#endif
 }
 
-static alloc_status _mem_add_to_gap_ix(pool_mgr_pt pool_mgr,
-                                       size_t size,
-                                       node_pt node) {
+// the size of the extents of a growable pool, all but pool.mem
+static size_t _mem_ext_total(pool_mgr_pt pool_mgr) {
+    size_t total = 0;
+    for (unsigned e = 0; e < pool_mgr->ext_dir_size; ++e) {
+        total += pool_mgr->ext_dir[e].size;
+    }
+    return total;
+}
 
-    // expand the gap index, if necessary (call the function)
-    _mem_resize_gap_ix(pool_mgr);
-    // add the entry at the end
-    pool_mgr->gap_ix[pool_mgr->pool.num_gaps].node = node;
-    pool_mgr->gap_ix[pool_mgr->pool.num_gaps].size = size;
-    // update metadata (num_gaps)
-    pool_mgr->pool.num_gaps ++;
-    // sort the gap index (call the function)
-    alloc_status sortCheck = _mem_sort_gap_ix(pool_mgr);
-    // check success
-    if(sortCheck == ALLOC_OK){
-        return ALLOC_OK;
+// makes every node unused without freeing a chunk: the nodes are zeroed,
+// the never-used ones are those of the last chunk, and the nodes of the
+// other chunks go on the free list, except the top node of the first chunk
+static void _mem_clear_node_heap(pool_mgr_pt pool_mgr) {
+    pool_mgr->node_free = NULL;
+    for (unsigned i = pool_mgr->node_dir_size; i-- > 0; ) {
+        node_pt chunk = pool_mgr->node_dir[i];
+        memset(chunk, 0, MEM_NODE_CHUNK_CAPACITY * sizeof(node_t));
+        if (chunk == pool_mgr->node_last) {
+            continue;
+        }
+        unsigned first = (chunk == pool_mgr->node_heap) ? 1 : 0;
+        for (unsigned u = MEM_NODE_CHUNK_CAPACITY; u > first; --u) {
+            chunk[u - 1].next = pool_mgr->node_free;
+            pool_mgr->node_free = &chunk[u - 1];
+        }
     }
-    return ALLOC_FAIL;
+    pool_mgr->node_top = (pool_mgr->node_last == pool_mgr->node_heap) ? 1 : 0;
+    pool_mgr->used_nodes = 0;
 }
 
-static alloc_status _mem_remove_from_gap_ix(pool_mgr_pt pool_mgr,
-                                            size_t size,
-                                            node_pt node) {
-    //debug("FUNCTION CALL: _mem_remove_from_gap_ix() has been called\n");
-    // find the position of the node in the gap index
-    int position = 0;
-    //Flag to determine if a match has been found
-    int flag = 0;
-    for(position; position < pool_mgr->gap_ix_capacity; position++){
-        //If we find the node....
-        if(pool_mgr->gap_ix[position].node == node){
-            flag = 1;
-            break;
+// grows the node heap until count more nodes fit within the fill factor
+static alloc_status _mem_reserve_nodes(pool_mgr_pt pool_mgr, unsigned count) {
+    while(((float)(pool_mgr->used_nodes + count) / (float)pool_mgr->total_nodes) > MEM_NODE_HEAP_FILL_FACTOR){
+        if(_mem_expand_node_heap(pool_mgr) != ALLOC_OK){
+            return ALLOC_FAIL;
+        }
+    }
+    return ALLOC_OK;
+}
+
+// takes a node that is not part of the list, NULL if the heap is full;
+// returned nodes are reused first, then the never-used ones above node_top
+static node_pt _mem_get_unused_node(pool_mgr_pt pool_mgr) {
+    node_pt node = pool_mgr->node_free;
+    if(node != NULL){
+        pool_mgr->node_free = node->next;
+        node->next = NULL;
+    } else if(pool_mgr->node_top < MEM_NODE_CHUNK_CAPACITY){
+        node = &pool_mgr->node_last[pool_mgr->node_top++];
+    } else {
+        return NULL;
+    }
+    pool_mgr->used_nodes++;
+    return node;
+}
+
+// clears a node that was unlinked from the list and puts it on the free list
+static void _mem_put_unused_node(pool_mgr_pt pool_mgr, node_pt node) {
+    memset(node, 0, sizeof(node_t));
+    node->next = pool_mgr->node_free;
+    pool_mgr->node_free = node;
+    pool_mgr->used_nodes--;
+}
+
+// maps a handle to its node, NULL unless it is the start of an allocated
+// node in one of this pool's chunks; the chunk is found by binary search in
+// the directory, comparing addresses as integers, so a foreign pointer is
+// never dereferenced
+static node_pt _mem_node_of(pool_mgr_pt pool_mgr, alloc_pt alloc) {
+    uintptr_t addr = (uintptr_t) alloc;
+    unsigned lo = 0, hi = pool_mgr->node_dir_size;
+
+    // find the last chunk that starts at or below addr
+    while(lo < hi){
+        unsigned mid = lo + (hi - lo) / 2;
+        if((uintptr_t) pool_mgr->node_dir[mid] <= addr){
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
     }
-    if(flag == 0){
-        // debug("FAIL: flag == 0 in _mem_remove_from_gap_ix");
+    if(lo == 0){
+        return NULL;
+    }
+
+    uintptr_t base = (uintptr_t) pool_mgr->node_dir[lo - 1];
+    if(addr - base >= (uintptr_t) MEM_NODE_CHUNK_CAPACITY * sizeof(node_t) ||
+       (addr - base) % sizeof(node_t) != 0){
+        return NULL;
+    }
+
+    node_pt node = &pool_mgr->node_dir[lo - 1][(addr - base) / sizeof(node_t)];
+    // (a slab page is not a handle)
+    if(!node->used || node->allocated != 1){
+        return NULL;
+    }
+    return node;
+}
+
+// cuts node down to size and links a new gap node for the rest right after it;
+// the caller accounts for the new gap in the gap index
+static node_pt _mem_split_node(pool_mgr_pt pool_mgr, node_pt node, size_t size) {
+    node_pt rest = _mem_get_unused_node(pool_mgr);
+    assert(rest);
+
+    //   initialize it to a gap node
+    rest->used = 1;
+    rest->allocated = 0;
+    rest->alloc_record.size = node->alloc_record.size - size;
+    rest->alloc_record.mem = node->alloc_record.mem + size;
+    node->alloc_record.size = size;
+
+    // update linked list (new node right after the split one)
+    rest->next = node->next;
+    if(node->next != NULL){
+        node->next->prev = rest;
+    }
+    node->next = rest;
+    rest->prev = node;
+
+    return rest;
+}
+
+
+// whether next starts where node ends; nodes next to each other in the list
+// always do, except the last node of an extent and the first of the next one
+static int _mem_contiguous(node_pt node, node_pt next) {
+    return node -> alloc_record.mem + node -> alloc_record.size == next -> alloc_record.mem;
+}
+
+// adds an extent of at least size bytes to a growable pool, as a gap at the
+// end of the list; each extent is MEM_EXPAND_FACTOR times the one before,
+// unless size needs more, so a pool grows a logarithmic number of times
+static alloc_status _mem_add_extent(pool_mgr_pt pool_mgr, size_t size) {
+    size_t last = (pool_mgr -> ext_dir_size > 0) ?
+                  pool_mgr -> ext_dir[pool_mgr -> ext_dir_size - 1].size :
+                  pool_mgr -> pool.total_size;
+    if (last <= (size_t) -1 / MEM_EXPAND_FACTOR && size < MEM_EXPAND_FACTOR * last) {
+        size = MEM_EXPAND_FACTOR * last;
+    }
+    if (size == 0 || size > (size_t) -1 - pool_mgr -> pool.total_size) {
         return ALLOC_FAIL;
     }
-    // loop from there to the end of the array:
-    while(position < pool_mgr->pool.num_gaps){
-        //    pull the entries (i.e. copy over) one position up
-        //    this effectively deletes the chosen node
-        pool_mgr->gap_ix[position] = pool_mgr->gap_ix[position + 1];
-        position++;
+
+    // make room in the extent directory and for the extent's node
+    if (pool_mgr -> ext_dir_size == pool_mgr -> ext_dir_capacity) {
+        unsigned capacity = (pool_mgr -> ext_dir_capacity == 0) ?
+                            MEM_EXT_DIR_INIT_CAPACITY :
+                            MEM_EXT_DIR_EXPAND_FACTOR * pool_mgr -> ext_dir_capacity;
+        extent_pt dir = (extent_pt) realloc(pool_mgr -> ext_dir, capacity * sizeof(extent_t));
+        if (dir == NULL) {
+            return ALLOC_FAIL;
+        }
+        pool_mgr -> ext_dir = dir;
+        pool_mgr -> ext_dir_capacity = capacity;
+    }
+    if (_mem_reserve_nodes(pool_mgr, 3) != ALLOC_OK) {
+        return ALLOC_FAIL;
     }
-    // update metadata (num_gaps)
-    pool_mgr->pool.num_gaps --;
-    // zero out the element at position num_gaps!
-    //This final gap_t is a copy of the second to last gap_t, so we need to NULL it out
-    pool_mgr->gap_ix[pool_mgr->pool.num_gaps].size = 0;
-    pool_mgr->gap_ix[pool_mgr->pool.num_gaps].node = NULL;
 
-    //*****DO WE WANT TO SORT THE GAP_IX HERE?*******
-    //Don't think we need to....
+    char *mem = (char *) malloc(size);
+    if (mem == NULL) {
+        return ALLOC_FAIL;
+    }
+    pool_mgr -> ext_dir[pool_mgr -> ext_dir_size].mem = mem;
+    pool_mgr -> ext_dir[pool_mgr -> ext_dir_size].size = size;
+    pool_mgr -> ext_dir_size++;
+    pool_mgr -> pool.total_size += size;
+
+    // the extent is one gap, linked after the last node (growing is rare
+    // enough for the walk to the end of the list)
+    node_pt last_node = pool_mgr -> node_heap;
+    while (last_node -> next != NULL) {
+        last_node = last_node -> next;
+    }
+    node_pt node = _mem_get_unused_node(pool_mgr);
+    node -> used = 1;
+    node -> allocated = 0;
+    node -> alloc_record.mem = mem;
+    node -> alloc_record.size = size;
+    node -> prev = last_node;
+    last_node -> next = node;
+
+    return _mem_add_to_gap_ix(pool_mgr, size, node);
+}
 
-    return ALLOC_OK;
+// the bytes from mem up to the next multiple of align (a power of two)
+static size_t _mem_align_pad(const char *mem, size_t align) {
+    return (size_t) (-(uintptr_t) mem & (align - 1));
 }
 
-// note: only called by _mem_add_to_gap_ix, which appends a single entry
-static alloc_status _mem_sort_gap_ix(pool_mgr_pt pool_mgr) {
-    //Check and see if gap_ix has 0 or 1 member, if so sorting is not required....
-    if(pool_mgr->pool.num_gaps <= 1){
-        return ALLOC_OK;
+// the slot of the gap the pool's policy picks for size, MEM_GAP_IX_NONE if
+// no gap is big enough
+static unsigned _mem_find_gap(pool_mgr_pt manager, size_t size) {
+
+    // if FIRST_FIT, then find the lowest sufficient gap in the gap index
+    if(manager -> pool.policy == FIRST_FIT) {
+        return _mem_find_first_gap(manager, size);
     }
 
-    // the new entry is at the end, so "bubble it up"
-    // loop from num_gaps - 1 until but not including 0:
-    int counter = pool_mgr->pool.num_gaps -1;
-    for(counter ; counter > 0 ; counter--){
-        //    if the size of the current entry is less than the previous (u - 1)
-        //    or if the sizes are the same but the current entry points to a
-        //    node with a lower address of pool allocation address (mem)
-        //       swap them (by copying) (remember to use a temporary variable)
-        gap_t gap1 = pool_mgr->gap_ix[counter];
-        gap_t gap2 = pool_mgr->gap_ix[counter-1];
-        if(gap1.size < gap2.size
-           || (gap1.size == gap2.size
-               && gap1.node->alloc_record.mem < gap2.node->alloc_record.mem)){
-            gap_t temp_gap_t = gap1;
-            gap1 = gap2;
-            gap2 = temp_gap_t;
+        // if NEXT_FIT, then find the lowest sufficient gap from the rover on,
+        // wrapping around to the start of the pool
+    else if (manager -> pool.policy == NEXT_FIT) {
+        unsigned slot = _mem_find_next_gap(manager, manager -> gap_ix_root, size, manager -> rover);
+        if (slot == MEM_GAP_IX_NONE) {
+            slot = _mem_find_first_gap(manager, size);
         }
+        return slot;
     }
-    return ALLOC_OK;
-}
\ No newline at end of file
+
+        // if WORST_FIT, then take the largest gap, the last one in the gap index
+    else if (manager -> pool.policy == WORST_FIT) {
+        unsigned slot = manager -> gap_ix_last;
+        if (slot != MEM_GAP_IX_NONE && manager -> gap_ix[slot].size < size) {
+            slot = MEM_GAP_IX_NONE;
+        }
+        return slot;
+    }
+
+        // if BEST_FIT, then find the smallest sufficient gap in the gap index
+    else if (manager -> pool.policy == BEST_FIT) {
+        return _mem_find_best_gap(manager, size);
+    }
+
+        // if SEGREGATED_FIT or TLSF, then take a gap from the size-class bins
+    else if (manager -> pool.policy == SEGREGATED_FIT || manager -> pool.policy == TLSF) {
+        return (manager -> pool.policy == TLSF) ?
+               _mem_find_tlsf_gap(manager, size) :
+               _mem_find_binned_gap(manager, size);
+    }
+    return MEM_GAP_IX_NONE;
+}
+
+// takes a gap by the pool's policy and cuts an allocated node of size out of
+// it, at the first address that is a multiple of align (a power of two); the
+// padding in front stays a gap of its own. The caller accounts for the
+// allocation in the pool metadata
+static node_pt _mem_carve_node(pool_mgr_pt manager, size_t size, size_t align) {
+
+    // expand heap node, if necessary, quit on error
+    if (((float) manager -> used_nodes / manager -> total_nodes) > MEM_NODE_HEAP_FILL_FACTOR) {
+        alloc_status resize = _mem_resize_node_heap(manager);
+        if (resize != ALLOC_OK) {
+            return NULL;
+        }
+    }
+
+    // check used nodes fewer than total nodes, quit on error
+    if (manager -> used_nodes >= manager -> total_nodes) {
+        return NULL;
+    }
+
+    // take the gap the policy picks for size if it fits aligned, otherwise
+    // the one it picks for size plus the largest padding, which always does
+    unsigned slot = _mem_find_gap(manager, size);
+    if (slot != MEM_GAP_IX_NONE && align > 1 &&
+        _mem_align_pad(manager -> gap_ix[slot].mem, align) > manager -> gap_ix[slot].size - size) {
+        slot = (size > (size_t) -1 - (align - 1)) ?
+               MEM_GAP_IX_NONE :
+               _mem_find_gap(manager, size + (align - 1));
+    }
+
+    // a growable pool adds an extent that fits it, padding and all
+    if (slot == MEM_GAP_IX_NONE && (manager -> flags & POOL_GROWABLE) &&
+        size <= (size_t) -1 - (align - 1) &&
+        _mem_add_extent(manager, size + (align - 1)) == ALLOC_OK) {
+        slot = _mem_find_gap(manager, size + (align - 1));
+    }
+
+    // check if node found
+    if (slot == MEM_GAP_IX_NONE) {
+        return NULL;
+    }
+    node_pt new_node = manager -> gap_ix[slot].node;
+    size_t pad = _mem_align_pad(new_node -> alloc_record.mem, align);
+
+    // calculate the size of the remaining gap, if any
+    // calculating the size left of one node
+    size_t size_of_gap = new_node -> alloc_record.size - pad - size;
+
+    // remove node from gap index
+    if(_mem_remove_from_gap_ix(manager, new_node -> alloc_record.size, new_node) != ALLOC_OK){
+        return NULL;
+    }
+
+    // the padding stays behind as a gap, the allocation starts after it
+    if (pad > 0) {
+        node_pt padding = new_node;
+        new_node = _mem_split_node(manager, padding, pad);
+        _mem_add_to_gap_ix(manager, pad, padding);
+    }
+
+    // convert gap_node to an allocation node of given size
+    new_node -> allocated = 1;
+    new_node -> used = 1;
+    new_node -> alloc_record.size = size;
+
+
+    // adjust node heap:
+    //   if remaining gap, need a new node right after the allocation
+    if (size_of_gap > 0) {
+        new_node -> alloc_record.size += size_of_gap;
+        node_pt new_gap_created = _mem_split_node(manager, new_node, size);
+
+        // add to gap index
+        _mem_add_to_gap_ix(manager, size_of_gap, new_gap_created);
+
+    }
+
+    // NEXT_FIT goes on from the end of the allocation
+    if (manager -> pool.policy == NEXT_FIT) {
+        manager -> rover = new_node -> alloc_record.mem + size;
+    }
+
+    return new_node;
+}
+
+// turns a node that has just stopped being allocated into a gap, merged with
+// a gap on either side, which removes at most two gap index entries and adds one
+static alloc_status _mem_release_node(pool_mgr_pt manager, node_pt delete_node) {
+
+    // if the next node in the list is also a gap, merge it into node-to-delete
+    node_pt next_node = delete_node -> next;
+    if (next_node != NULL && next_node -> allocated == 0 && _mem_contiguous(delete_node, next_node)) {
+
+        //   remove the next node from gap index
+        _mem_remove_from_gap_ix(manager, next_node->alloc_record.size, next_node);
+
+        //   add the size to the node-to-delete
+        delete_node->alloc_record.size += next_node->alloc_record.size;
+
+        //   update linked list
+        delete_node->next = next_node->next;
+        if (next_node->next) {
+            next_node->next->prev = delete_node;
+        }
+
+        //   update node as unused (updates used_nodes)
+        _mem_put_unused_node(manager, next_node);
+    }
+
+    // if the previous node in the list is also a gap, merge node-to-delete into it
+    node_pt previous_node = delete_node -> prev;
+    if (previous_node != NULL && previous_node -> allocated == 0 && _mem_contiguous(previous_node, delete_node)) {
+
+        //   remove the previous node from gap index
+        _mem_remove_from_gap_ix(manager, previous_node->alloc_record.size, previous_node);
+
+        //   add the size of node-to-delete to the previous
+        previous_node->alloc_record.size += delete_node->alloc_record.size;
+
+        //   update linked list
+        previous_node->next = delete_node->next;
+        if (delete_node->next) {
+            delete_node->next->prev = previous_node;
+        }
+
+        //   update node-to-delete as unused (updates used_nodes)
+        _mem_put_unused_node(manager, delete_node);
+
+        //   the previous node is the merged gap now
+        delete_node = previous_node;
+    }
+
+    // a rover inside the merged gap moves back to its start
+    if (manager -> rover > delete_node->alloc_record.mem &&
+        manager -> rover < delete_node->alloc_record.mem + delete_node->alloc_record.size) {
+        manager -> rover = delete_node->alloc_record.mem;
+    }
+
+    // the merged gap enters the gap index once
+    return _mem_add_to_gap_ix(manager, delete_node->alloc_record.size, delete_node);
+}
+
+// changes the size of an allocated node where it is: shrinking leaves a gap
+// after it, and growing takes the start of the gap after it, which fails if
+// there is none or it is too small
+static alloc_status _mem_resize_node(pool_mgr_pt manager, node_pt node, size_t size) {
+    size_t old_size = node -> alloc_record.size;
+
+    if (size < old_size) {
+        // the cut-off end is released like a deallocation, so it merges
+        // with a gap after it (the heap has room for its node when it is
+        // not over the fill factor)
+        if (_mem_resize_node_heap(manager) != ALLOC_OK) {
+            return ALLOC_FAIL;
+        }
+        node_pt rest = _mem_split_node(manager, node, size);
+        manager -> pool.alloc_size -= old_size - size;
+        return _mem_release_node(manager, rest);
+    }
+
+    if (size > old_size) {
+        size_t more = size - old_size;
+        node_pt next_node = node -> next;
+        if (next_node == NULL || next_node -> allocated != 0 || next_node -> alloc_record.size < more ||
+            !_mem_contiguous(node, next_node)) {
+            return ALLOC_FAIL;
+        }
+
+        _mem_remove_from_gap_ix(manager, next_node -> alloc_record.size, next_node);
+        if (next_node -> alloc_record.size == more) {
+            //   the gap is used up, unlink its node
+            node -> next = next_node -> next;
+            if (next_node -> next) {
+                next_node -> next -> prev = node;
+            }
+            _mem_put_unused_node(manager, next_node);
+        } else {
+            //   the gap starts further up now
+            next_node -> alloc_record.mem += more;
+            next_node -> alloc_record.size -= more;
+            _mem_add_to_gap_ix(manager, next_node -> alloc_record.size, next_node);
+        }
+        node -> alloc_record.size = size;
+        manager -> pool.alloc_size += more;
+    }
+
+    return ALLOC_OK;
+}
+
+
+// carves the requests of a batch that have no allocation in out yet; the
+// node heap grows once for all of them, and consecutive requests are packed
+// into one gap, which leaves the gap index once and returns once as the
+// rest of the gap. The gap is the one the policy picks for all the requests
+// left, or failing that for the next one. Fails if a request fits no gap,
+// leaving what was carved so far allocated
+static alloc_status _mem_carve_batch(pool_mgr_pt manager, const size_t *sizes, size_t n, alloc_pt *out) {
+    size_t total = 0, count = 0;
+
+    // a node per request is enough: each one cuts at most one off its gap
+    for (size_t i = 0; i < n; ++i) {
+        if (out[i] == NULL) {
+            if (sizes[i] > (size_t) -1 - total) {
+                return ALLOC_FAIL;
+            }
+            total += sizes[i];
+            ++count;
+        }
+    }
+    if (count > (size_t) ((unsigned) -1 - manager -> used_nodes) ||
+        _mem_reserve_nodes(manager, (unsigned) count) != ALLOC_OK) {
+        return ALLOC_FAIL;
+    }
+
+    size_t i = 0;
+    while (count > 0) {
+        while (out[i] != NULL) {
+            ++i;
+        }
+
+        // one gap for the rest of the batch, if the policy has one
+        unsigned slot = _mem_find_gap(manager, total);
+        if (slot == MEM_GAP_IX_NONE) {
+            slot = _mem_find_gap(manager, sizes[i]);
+        }
+
+        // or an extent for the rest of it, in a growable pool
+        if (slot == MEM_GAP_IX_NONE && (manager -> flags & POOL_GROWABLE) &&
+            _mem_add_extent(manager, total) == ALLOC_OK &&
+            _mem_reserve_nodes(manager, (unsigned) count) == ALLOC_OK) {
+            slot = _mem_find_gap(manager, total);
+        }
+        if (slot == MEM_GAP_IX_NONE) {
+            return ALLOC_FAIL;
+        }
+        node_pt node = manager -> gap_ix[slot].node;
+        if (_mem_remove_from_gap_ix(manager, node -> alloc_record.size, node) != ALLOC_OK) {
+            return ALLOC_FAIL;
+        }
+
+        // allocate the requests in a row, as long as they fit
+        for (; i < n && node != NULL; ++i) {
+            if (out[i] != NULL) {
+                continue;
+            }
+            if (sizes[i] > node -> alloc_record.size) {
+                break;
+            }
+            node_pt alloc_node = node;
+            node = (sizes[i] < alloc_node -> alloc_record.size) ?
+                   _mem_split_node(manager, alloc_node, sizes[i]) :
+                   NULL;
+            alloc_node -> allocated = 1;
+            out[i] = (alloc_pt) alloc_node;
+
+            manager -> pool.num_allocs++;
+            manager -> pool.alloc_size += sizes[i];
+            total -= sizes[i];
+            --count;
+        }
+
+        // what is left of the gap goes back once
+        if (node != NULL) {
+            _mem_add_to_gap_ix(manager, node -> alloc_record.size, node);
+            if (manager -> pool.policy == NEXT_FIT) {
+                manager -> rover = node -> alloc_record.mem;
+            }
+        } else if (manager -> pool.policy == NEXT_FIT) {
+            manager -> rover = out[i - 1] -> mem + out[i - 1] -> size;
+        }
+    }
+
+    return ALLOC_OK;
+}
+
+
+// sorts batch nodes by offset, a byte at a time from the lowest (a radix
+// sort, so the batch is sorted in linear time), up to the highest byte an
+// offset below range has; tmp has room for count keys, and the sorted keys
+// end up in either array, the one returned
+static node_key_pt _mem_sort_node_keys(node_key_pt keys, node_key_pt tmp, size_t count, size_t range) {
+    for (unsigned shift = 0; shift < 8 * sizeof(size_t) && (range >> shift) > 0; shift += 8) {
+        size_t start[257] = { 0 };
+
+        // where the keys of each byte value start
+        for (size_t i = 0; i < count; ++i) {
+            start[((keys[i].offset >> shift) & 0xff) + 1]++;
+        }
+        for (unsigned d = 0; d < 256; ++d) {
+            start[d + 1] += start[d];
+        }
+
+        // move them there, keeping the order of the lower bytes
+        for (size_t i = 0; i < count; ++i) {
+            tmp[start[(keys[i].offset >> shift) & 0xff]++] = keys[i];
+        }
+        node_key_pt sorted = tmp;
+        tmp = keys;
+        keys = sorted;
+    }
+    return keys;
+}
+
+// turns nodes that have just stopped being allocated, sorted by address,
+// into gaps in one pass over the list: each run of them, together with the
+// gaps before, between, and after them, becomes one gap, which enters the
+// gap index once; each gap merged into it leaves the index once
+static void _mem_release_batch(pool_mgr_pt manager, node_key_pt keys, size_t count) {
+    for (size_t k = 0; k < count; ++k) {
+        node_pt gap = keys[k].node;
+
+        // a gap before the run is where it starts
+        if (gap -> prev != NULL && gap -> prev -> allocated == 0 && _mem_contiguous(gap -> prev, gap)) {
+            gap = gap -> prev;
+            _mem_remove_from_gap_ix(manager, gap -> alloc_record.size, gap);
+        }
+
+        // take in the nodes of the batch and the gaps that follow in a row
+        size_t next_k = (gap == keys[k].node) ? k + 1 : k;
+        node_pt next_node = gap -> next;
+        while (next_node != NULL && next_node -> allocated == 0 && _mem_contiguous(gap, next_node)) {
+            if (next_k < count && keys[next_k].node == next_node) {
+                ++next_k;
+            } else {
+                _mem_remove_from_gap_ix(manager, next_node -> alloc_record.size, next_node);
+            }
+            gap -> alloc_record.size += next_node -> alloc_record.size;
+            gap -> next = next_node -> next;
+            if (next_node -> next) {
+                next_node -> next -> prev = gap;
+            }
+            _mem_put_unused_node(manager, next_node);
+            next_node = gap -> next;
+        }
+        k = next_k - 1;
+
+        // a rover inside the merged gap moves back to its start
+        if (manager -> rover > gap -> alloc_record.mem &&
+            manager -> rover < gap -> alloc_record.mem + gap -> alloc_record.size) {
+            manager -> rover = gap -> alloc_record.mem;
+        }
+
+        _mem_add_to_gap_ix(manager, gap -> alloc_record.size, gap);
+    }
+}
+
+
+// empties the gap index, keeping its capacity
+static void _mem_clear_gap_ix(pool_mgr_pt pool_mgr) {
+    pool_mgr->gap_ix_root = MEM_GAP_IX_NONE;
+    pool_mgr->gap_ix_last = MEM_GAP_IX_NONE;
+    pool_mgr->gap_ix_free = MEM_GAP_IX_NONE;
+    pool_mgr->gap_ix_top = 0;
+    for(int i = 0; i < MEM_NUM_BINS; ++i){
+        for(int j = 0; j < MEM_NUM_SUBBINS; ++j){
+            pool_mgr->bin_head[i][j] = MEM_GAP_IX_NONE;
+        }
+        pool_mgr->subbin_map[i] = 0;
+    }
+    pool_mgr->bin_map = 0;
+}
+
+static alloc_status _mem_resize_gap_ix(pool_mgr_pt pool_mgr) {
+
+    //Does gap_ix need to be resized?
+    if((((float)pool_mgr->pool.num_gaps)/(pool_mgr->gap_ix_capacity)) > MEM_GAP_IX_FILL_FACTOR){
+        //resize if needed
+        //Perform realloc to increase size of gap_ix
+        //  the tree is linked by slot numbers, so moving the array is harmless
+        gap_pt new_ix = realloc(pool_mgr->gap_ix,
+                                MEM_GAP_IX_EXPAND_FACTOR * pool_mgr->gap_ix_capacity * sizeof(gap_t));
+        //Check and make sure it worked
+        if(NULL == new_ix){
+
+            return ALLOC_FAIL;
+        }
+        //update metadata
+        //  Expand the gap_ix_capacity by the same factor as the realloc
+        pool_mgr->gap_ix = new_ix;
+        pool_mgr->gap_ix_capacity *= MEM_GAP_IX_EXPAND_FACTOR;
+        return ALLOC_OK;
+    }
+    return ALLOC_OK;
+}
+
+
+/* AVL helpers for the gap index (all take and return slot numbers) */
+
+// order of gap entries: by size, ties broken by the address of the gap;
+// FIRST_FIT and NEXT_FIT order by address alone
+static int _mem_gap_cmp(pool_mgr_pt pool_mgr,
+                        size_t size_a, const char *mem_a, size_t size_b, const char *mem_b) {
+    if (size_a != size_b &&
+        pool_mgr->pool.policy != FIRST_FIT && pool_mgr->pool.policy != NEXT_FIT) {
+        return (size_a < size_b) ? -1 : 1;
+    }
+    if (mem_a != mem_b) {
+        return (mem_a < mem_b) ? -1 : 1;
+    }
+    return 0;
+}
+
+static int _mem_gap_height(pool_mgr_pt pool_mgr, unsigned slot) {
+    return (slot == MEM_GAP_IX_NONE) ? 0 : pool_mgr->gap_ix[slot].height;
+}
+
+static size_t _mem_gap_max_size(pool_mgr_pt pool_mgr, unsigned slot) {
+    return (slot == MEM_GAP_IX_NONE) ? 0 : pool_mgr->gap_ix[slot].max_size;
+}
+
+// recomputes the height and max_size of a slot from its children
+static void _mem_gap_update(pool_mgr_pt pool_mgr, unsigned slot) {
+    gap_pt gap = &pool_mgr->gap_ix[slot];
+    int hl = _mem_gap_height(pool_mgr, gap->left);
+    int hr = _mem_gap_height(pool_mgr, gap->right);
+    size_t ml = _mem_gap_max_size(pool_mgr, gap->left);
+    size_t mr = _mem_gap_max_size(pool_mgr, gap->right);
+    gap->height = 1 + ((hl > hr) ? hl : hr);
+    gap->max_size = gap->size;
+    if (ml > gap->max_size) {
+        gap->max_size = ml;
+    }
+    if (mr > gap->max_size) {
+        gap->max_size = mr;
+    }
+}
+
+static unsigned _mem_gap_rotate_right(pool_mgr_pt pool_mgr, unsigned slot) {
+    unsigned pivot = pool_mgr->gap_ix[slot].left;
+    pool_mgr->gap_ix[slot].left = pool_mgr->gap_ix[pivot].right;
+    pool_mgr->gap_ix[pivot].right = slot;
+    _mem_gap_update(pool_mgr, slot);
+    _mem_gap_update(pool_mgr, pivot);
+    return pivot;
+}
+
+static unsigned _mem_gap_rotate_left(pool_mgr_pt pool_mgr, unsigned slot) {
+    unsigned pivot = pool_mgr->gap_ix[slot].right;
+    pool_mgr->gap_ix[slot].right = pool_mgr->gap_ix[pivot].left;
+    pool_mgr->gap_ix[pivot].left = slot;
+    _mem_gap_update(pool_mgr, slot);
+    _mem_gap_update(pool_mgr, pivot);
+    return pivot;
+}
+
+static unsigned _mem_gap_balance(pool_mgr_pt pool_mgr, unsigned slot) {
+    gap_pt gap = &pool_mgr->gap_ix[slot];
+    int diff;
+
+    _mem_gap_update(pool_mgr, slot);
+    diff = _mem_gap_height(pool_mgr, gap->left) - _mem_gap_height(pool_mgr, gap->right);
+
+    if (diff > 1) {
+        gap_pt left = &pool_mgr->gap_ix[gap->left];
+        if (_mem_gap_height(pool_mgr, left->left) < _mem_gap_height(pool_mgr, left->right)) {
+            gap->left = _mem_gap_rotate_left(pool_mgr, gap->left);
+        }
+        return _mem_gap_rotate_right(pool_mgr, slot);
+    }
+    if (diff < -1) {
+        gap_pt right = &pool_mgr->gap_ix[gap->right];
+        if (_mem_gap_height(pool_mgr, right->right) < _mem_gap_height(pool_mgr, right->left)) {
+            gap->right = _mem_gap_rotate_right(pool_mgr, gap->right);
+        }
+        return _mem_gap_rotate_left(pool_mgr, slot);
+    }
+    return slot;
+}
+
+static unsigned _mem_gap_insert(pool_mgr_pt pool_mgr, unsigned root, unsigned slot) {
+    if (root == MEM_GAP_IX_NONE) {
+        return slot;
+    }
+
+    gap_pt gap = &pool_mgr->gap_ix[slot];
+    gap_pt here = &pool_mgr->gap_ix[root];
+    if (_mem_gap_cmp(pool_mgr, gap->size, gap->mem, here->size, here->mem) < 0) {
+        here->left = _mem_gap_insert(pool_mgr, here->left, slot);
+    } else {
+        here->right = _mem_gap_insert(pool_mgr, here->right, slot);
+    }
+    return _mem_gap_balance(pool_mgr, root);
+}
+
+// unlinks the leftmost slot of the subtree into *min, returns the new subtree root
+static unsigned _mem_gap_remove_min(pool_mgr_pt pool_mgr, unsigned root, unsigned *min) {
+    gap_pt here = &pool_mgr->gap_ix[root];
+    if (here->left == MEM_GAP_IX_NONE) {
+        *min = root;
+        return here->right;
+    }
+    here->left = _mem_gap_remove_min(pool_mgr, here->left, min);
+    return _mem_gap_balance(pool_mgr, root);
+}
+
+// unlinks the entry for (size, mem) into *removed, returns the new subtree root
+static unsigned _mem_gap_remove(pool_mgr_pt pool_mgr, unsigned root,
+                                size_t size, const char *mem, unsigned *removed) {
+    if (root == MEM_GAP_IX_NONE) {
+        return MEM_GAP_IX_NONE;
+    }
+
+    gap_pt here = &pool_mgr->gap_ix[root];
+    int cmp = _mem_gap_cmp(pool_mgr, size, mem, here->size, here->mem);
+    if (cmp < 0) {
+        here->left = _mem_gap_remove(pool_mgr, here->left, size, mem, removed);
+    } else if (cmp > 0) {
+        here->right = _mem_gap_remove(pool_mgr, here->right, size, mem, removed);
+    } else {
+        unsigned left = here->left;
+        unsigned right = here->right;
+        unsigned successor;
+
+        *removed = root;
+        if (right == MEM_GAP_IX_NONE) {
+            return left;
+        }
+        right = _mem_gap_remove_min(pool_mgr, right, &successor);
+        pool_mgr->gap_ix[successor].left = left;
+        pool_mgr->gap_ix[successor].right = right;
+        return _mem_gap_balance(pool_mgr, successor);
+    }
+    return _mem_gap_balance(pool_mgr, root);
+}
+
+
+/* Size-class bins for SEGREGATED_FIT and TLSF (all take and return slot numbers) */
+
+// index of the lowest set bit, word must not be 0
+static unsigned _mem_ctz(uint64_t word) {
+#if defined(__GNUC__)
+    return (unsigned) __builtin_ctzll(word);
+#else
+    unsigned bit = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+// index of the highest set bit, word must not be 0
+static unsigned _mem_log2(uint64_t word) {
+#if defined(__GNUC__)
+    return 63 - (unsigned) __builtin_clzll(word);
+#else
+    unsigned bit = 0;
+    while (word >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+static int _mem_uses_bins(pool_mgr_pt pool_mgr) {
+    return pool_mgr->pool.policy == SEGREGATED_FIT ||
+           pool_mgr->pool.policy == TLSF ||
+           pool_mgr->pool.policy == BUDDY;
+}
+
+// class c holds the gaps with 2^c <= size < 2^(c+1); TLSF splits the class
+// into MEM_NUM_SUBBINS equal ranges by the bits below the top one
+static void _mem_bin_of(pool_mgr_pt pool_mgr, size_t size, unsigned *bin, unsigned *subbin) {
+    *bin = _mem_log2(size);
+    if (pool_mgr->pool.policy != TLSF) {
+        *subbin = 0;
+    } else if (*bin >= MEM_NUM_SUBBIN_BITS) {
+        *subbin = (unsigned) (size >> (*bin - MEM_NUM_SUBBIN_BITS)) - MEM_NUM_SUBBINS;
+    } else {
+        *subbin = (unsigned) (size << (MEM_NUM_SUBBIN_BITS - *bin)) - MEM_NUM_SUBBINS;
+    }
+}
+
+static void _mem_bin_insert(pool_mgr_pt pool_mgr, unsigned slot) {
+    unsigned bin, subbin;
+    _mem_bin_of(pool_mgr, pool_mgr->gap_ix[slot].size, &bin, &subbin);
+    unsigned head = pool_mgr->bin_head[bin][subbin];
+
+    // push at the head, so recently freed gaps are reused first
+    pool_mgr->gap_ix[slot].bin_prev = MEM_GAP_IX_NONE;
+    pool_mgr->gap_ix[slot].bin_next = head;
+    if (head != MEM_GAP_IX_NONE) {
+        pool_mgr->gap_ix[head].bin_prev = slot;
+    }
+    pool_mgr->bin_head[bin][subbin] = slot;
+    pool_mgr->subbin_map[bin] |= (uint32_t) 1 << subbin;
+    pool_mgr->bin_map |= (uint64_t) 1 << bin;
+}
+
+static void _mem_bin_remove(pool_mgr_pt pool_mgr, unsigned slot) {
+    unsigned bin, subbin;
+    _mem_bin_of(pool_mgr, pool_mgr->gap_ix[slot].size, &bin, &subbin);
+    unsigned prev = pool_mgr->gap_ix[slot].bin_prev;
+    unsigned next = pool_mgr->gap_ix[slot].bin_next;
+
+    if (prev != MEM_GAP_IX_NONE) {
+        pool_mgr->gap_ix[prev].bin_next = next;
+    } else {
+        pool_mgr->bin_head[bin][subbin] = next;
+    }
+    if (next != MEM_GAP_IX_NONE) {
+        pool_mgr->gap_ix[next].bin_prev = prev;
+    }
+    if (pool_mgr->bin_head[bin][subbin] == MEM_GAP_IX_NONE) {
+        pool_mgr->subbin_map[bin] &= ~((uint32_t) 1 << subbin);
+        if (pool_mgr->subbin_map[bin] == 0) {
+            pool_mgr->bin_map &= ~((uint64_t) 1 << bin);
+        }
+    }
+}
+
+static alloc_status _mem_add_to_gap_ix(pool_mgr_pt pool_mgr,
+                                       size_t size,
+                                       node_pt node) {
+
+    // expand the gap index, if necessary (call the function)
+    if(_mem_resize_gap_ix(pool_mgr) != ALLOC_OK){
+        return ALLOC_FAIL;
+    }
+
+    // take a recycled slot, or the next never-used one
+    unsigned slot = pool_mgr->gap_ix_free;
+    if(slot != MEM_GAP_IX_NONE){
+        pool_mgr->gap_ix_free = pool_mgr->gap_ix[slot].left;
+    } else {
+        slot = pool_mgr->gap_ix_top++;
+    }
+
+    // fill in the entry and link it into the tree or its bin
+    pool_mgr->gap_ix[slot].size = size;
+    pool_mgr->gap_ix[slot].mem = node->alloc_record.mem;
+    pool_mgr->gap_ix[slot].node = node;
+    pool_mgr->gap_ix[slot].left = MEM_GAP_IX_NONE;
+    pool_mgr->gap_ix[slot].right = MEM_GAP_IX_NONE;
+    pool_mgr->gap_ix[slot].height = 1;
+    pool_mgr->gap_ix[slot].max_size = size;
+    node->gap_slot = slot;
+    if(_mem_uses_bins(pool_mgr)){
+        _mem_bin_insert(pool_mgr, slot);
+    } else {
+        pool_mgr->gap_ix_root = _mem_gap_insert(pool_mgr, pool_mgr->gap_ix_root, slot);
+
+        // a new largest entry becomes the last one
+        unsigned last = pool_mgr->gap_ix_last;
+        if(last == MEM_GAP_IX_NONE ||
+           _mem_gap_cmp(pool_mgr, size, node->alloc_record.mem,
+                        pool_mgr->gap_ix[last].size, pool_mgr->gap_ix[last].mem) > 0){
+            pool_mgr->gap_ix_last = slot;
+        }
+    }
+
+    // update metadata (num_gaps)
+    pool_mgr->pool.num_gaps ++;
+
+    return ALLOC_OK;
+}
+
+static alloc_status _mem_remove_from_gap_ix(pool_mgr_pt pool_mgr,
+                                            size_t size,
+                                            node_pt node) {
+    // the node knows its entry
+    unsigned slot = node->gap_slot;
+    if(slot >= pool_mgr->gap_ix_top || pool_mgr->gap_ix[slot].node != node ||
+       pool_mgr->gap_ix[slot].size != size){
+        return ALLOC_FAIL;
+    }
+
+    if(_mem_uses_bins(pool_mgr)){
+        // unlink it from its bin directly
+        _mem_bin_remove(pool_mgr, slot);
+    } else {
+        // unlink it from the tree by the key stored in the entry
+        unsigned removed = MEM_GAP_IX_NONE;
+        pool_mgr->gap_ix_root = _mem_gap_remove(pool_mgr, pool_mgr->gap_ix_root,
+                                                size, pool_mgr->gap_ix[slot].mem, &removed);
+        assert(removed == slot);
+
+        // removing the last entry makes its predecessor the last one
+        if(slot == pool_mgr->gap_ix_last){
+            unsigned last = pool_mgr->gap_ix_root;
+            while(last != MEM_GAP_IX_NONE && pool_mgr->gap_ix[last].right != MEM_GAP_IX_NONE){
+                last = pool_mgr->gap_ix[last].right;
+            }
+            pool_mgr->gap_ix_last = last;
+        }
+    }
+
+    // zero out the entry and put the slot on the free chain
+    pool_mgr->gap_ix[slot].size = 0;
+    pool_mgr->gap_ix[slot].node = NULL;
+    pool_mgr->gap_ix[slot].left = pool_mgr->gap_ix_free;
+    pool_mgr->gap_ix_free = slot;
+
+    // update metadata (num_gaps)
+    pool_mgr->pool.num_gaps --;
+
+    return ALLOC_OK;
+}
+
+// lower bound on (size, lowest address): the slot of the smallest sufficient gap
+static unsigned _mem_find_best_gap(pool_mgr_pt pool_mgr, size_t size) {
+    unsigned best = MEM_GAP_IX_NONE;
+    unsigned slot = pool_mgr->gap_ix_root;
+
+    while(slot != MEM_GAP_IX_NONE){
+        if(pool_mgr->gap_ix[slot].size >= size){
+            best = slot;
+            slot = pool_mgr->gap_ix[slot].left;
+        } else {
+            slot = pool_mgr->gap_ix[slot].right;
+        }
+    }
+    return best;
+}
+
+// the slot of the lowest-addressed sufficient gap: descend into the left
+// subtree while it holds a gap that fits, otherwise take this gap or go right
+static unsigned _mem_find_first_gap(pool_mgr_pt pool_mgr, size_t size) {
+    unsigned slot = pool_mgr->gap_ix_root;
+
+    if(_mem_gap_max_size(pool_mgr, slot) < size){
+        return MEM_GAP_IX_NONE;
+    }
+    while(1){
+        gap_pt gap = &pool_mgr->gap_ix[slot];
+        if(_mem_gap_max_size(pool_mgr, gap->left) >= size){
+            slot = gap->left;
+        } else if(gap->size >= size){
+            return slot;
+        } else {
+            slot = gap->right;
+        }
+    }
+}
+
+// the slot of the lowest-addressed sufficient gap at or above from in the
+// subtree; only the path along from and one subtree past it are searched
+static unsigned _mem_find_next_gap(pool_mgr_pt pool_mgr, unsigned slot, size_t size, const char *from) {
+    while(slot != MEM_GAP_IX_NONE && _mem_gap_max_size(pool_mgr, slot) >= size){
+        gap_pt gap = &pool_mgr->gap_ix[slot];
+        if(gap->mem < from){
+            slot = gap->right;
+            continue;
+        }
+
+        // everything right of here is above from, so the search ends here
+        unsigned found = _mem_find_next_gap(pool_mgr, gap->left, size, from);
+        if(found != MEM_GAP_IX_NONE){
+            return found;
+        }
+        if(gap->size >= size){
+            return slot;
+        }
+        slot = gap->right;
+        if(_mem_gap_max_size(pool_mgr, slot) < size){
+            return MEM_GAP_IX_NONE;
+        }
+        while(1){
+            gap = &pool_mgr->gap_ix[slot];
+            if(_mem_gap_max_size(pool_mgr, gap->left) >= size){
+                slot = gap->left;
+            } else if(gap->size >= size){
+                return slot;
+            } else {
+                slot = gap->right;
+            }
+        }
+    }
+    return MEM_GAP_IX_NONE;
+}
+
+// a gap from the request's own class if one of the first few fits,
+// otherwise the head of the smallest nonempty larger class
+static unsigned _mem_find_binned_gap(pool_mgr_pt pool_mgr, size_t size) {
+    unsigned bin, subbin;
+    _mem_bin_of(pool_mgr, size, &bin, &subbin);
+    unsigned slot = pool_mgr->bin_head[bin][0];
+
+    for(unsigned probes = 0; slot != MEM_GAP_IX_NONE && probes < MEM_BIN_MAX_PROBES; ++probes){
+        if(pool_mgr->gap_ix[slot].size >= size){
+            return slot;
+        }
+        slot = pool_mgr->gap_ix[slot].bin_next;
+    }
+
+    // every gap in a larger class is big enough
+    uint64_t larger = (bin + 1 < MEM_NUM_BINS) ? (pool_mgr->bin_map >> (bin + 1)) << (bin + 1) : 0;
+    if(larger == 0){
+        return MEM_GAP_IX_NONE;
+    }
+    return pool_mgr->bin_head[_mem_ctz(larger)][0];
+}
+
+// TLSF: round the request up to the next bin boundary, so that every gap in
+// that bin or any later one fits, then take the head of the first nonempty one
+static unsigned _mem_find_tlsf_gap(pool_mgr_pt pool_mgr, size_t size) {
+    unsigned bin, subbin;
+    unsigned top = _mem_log2(size);
+    size_t rounded = size;
+
+    if(top >= MEM_NUM_SUBBIN_BITS){
+        rounded = size + ((size_t) 1 << (top - MEM_NUM_SUBBIN_BITS)) - 1;
+        if(rounded < size){
+            return MEM_GAP_IX_NONE;
+        }
+    }
+    _mem_bin_of(pool_mgr, rounded, &bin, &subbin);
+
+    // a bin of the same class at or after the rounded one
+    uint32_t subbins = pool_mgr->subbin_map[bin] & (~(uint32_t) 0 << subbin);
+    if(subbins == 0){
+        // otherwise the first nonempty bin of a larger class
+        uint64_t larger = (bin + 1 < MEM_NUM_BINS) ? (pool_mgr->bin_map >> (bin + 1)) << (bin + 1) : 0;
+        if(larger != 0){
+            bin = _mem_ctz(larger);
+            subbins = pool_mgr->subbin_map[bin];
+        }
+    }
+    if(subbins != 0){
+        return pool_mgr->bin_head[bin][_mem_ctz(subbins)];
+    }
+
+    // nothing is certain to fit, but a gap in the request's own bin still may
+    _mem_bin_of(pool_mgr, size, &bin, &subbin);
+    unsigned slot = pool_mgr->bin_head[bin][subbin];
+    for(unsigned probes = 0; slot != MEM_GAP_IX_NONE && probes < MEM_BIN_MAX_PROBES; ++probes){
+        if(pool_mgr->gap_ix[slot].size >= size){
+            return slot;
+        }
+        slot = pool_mgr->gap_ix[slot].bin_next;
+    }
+    return MEM_GAP_IX_NONE;
+}
+
+
+/* Binary buddy system for BUDDY (block offsets are relative to pool.mem) */
+
+// the order of the smallest block that holds size bytes, 64 if none does
+static unsigned _mem_buddy_order(size_t size) {
+    unsigned order = MEM_BUDDY_MIN_ORDER;
+    if(size > ((size_t) 1 << MEM_BUDDY_MIN_ORDER)){
+        order = _mem_log2(size - 1) + 1;
+    }
+    return order;
+}
+
+// splits the initial whole-pool gap into the binary digits of the pool size,
+// largest first, so that every block is aligned to its own size
+static alloc_status _mem_buddy_carve(pool_mgr_pt pool_mgr) {
+    node_pt node = pool_mgr->node_heap;
+    size_t rest = node->alloc_record.size;
+
+    if(_mem_reserve_nodes(pool_mgr, 64) != ALLOC_OK){
+        return ALLOC_FAIL;
+    }
+    node = pool_mgr->node_heap;
+    _mem_remove_from_gap_ix(pool_mgr, rest, node);
+
+    while(1){
+        size_t block = (size_t) 1 << _mem_log2(rest);
+        if(block < rest){
+            _mem_split_node(pool_mgr, node, block);
+        }
+        _mem_add_to_gap_ix(pool_mgr, block, node);
+        rest -= block;
+        if(rest == 0){
+            break;
+        }
+        node = node->next;
+    }
+    return ALLOC_OK;
+}
+
+static node_pt _mem_buddy_alloc(pool_mgr_pt pool_mgr, size_t size) {
+    unsigned order = _mem_buddy_order(size);
+    if(order >= MEM_NUM_BINS){
+        return NULL;
+    }
+
+    // the smallest nonempty order at or above the request
+    uint64_t orders = (pool_mgr->bin_map >> order) << order;
+    if(orders == 0){
+        return NULL;
+    }
+    unsigned have = _mem_ctz(orders);
+
+    // every split needs a node, so make room before touching anything
+    if(_mem_reserve_nodes(pool_mgr, have - order) != ALLOC_OK){
+        return NULL;
+    }
+    node_pt node = pool_mgr->gap_ix[pool_mgr->bin_head[have][0]].node;
+    _mem_remove_from_gap_ix(pool_mgr, node->alloc_record.size, node);
+
+    // halve the block until it has the right order, freeing the upper halves
+    while(have > order){
+        --have;
+        node_pt upper = _mem_split_node(pool_mgr, node, (size_t) 1 << have);
+        _mem_add_to_gap_ix(pool_mgr, upper->alloc_record.size, upper);
+    }
+
+    node->allocated = 1;
+    pool_mgr->pool.num_allocs++;
+    pool_mgr->pool.alloc_size += node->alloc_record.size;
+
+    return node;
+}
+
+// the buddy of a block is the neighbor at offset ^ size, if that neighbor
+// is a free block of the same size; merge with it as long as there is one
+static alloc_status _mem_buddy_free(pool_mgr_pt pool_mgr, node_pt node) {
+    while(1){
+        size_t size = node->alloc_record.size;
+        size_t offset = (size_t) (node->alloc_record.mem - pool_mgr->pool.mem);
+        node_pt buddy = ((offset ^ size) < offset) ? node->prev : node->next;
+
+        if(buddy == NULL || buddy->allocated ||
+           buddy->alloc_record.size != size ||
+           buddy->alloc_record.mem != pool_mgr->pool.mem + (offset ^ size)){
+            break;
+        }
+        _mem_remove_from_gap_ix(pool_mgr, size, buddy);
+
+        // the lower of the two survives
+        node_pt lower = (buddy == node->prev) ? buddy : node;
+        node_pt upper = lower->next;
+        lower->alloc_record.size = 2 * size;
+        lower->next = upper->next;
+        if(upper->next != NULL){
+            upper->next->prev = lower;
+        }
+        _mem_put_unused_node(pool_mgr, upper);
+
+        node = lower;
+    }
+    return _mem_add_to_gap_ix(pool_mgr, node->alloc_record.size, node);
+}
+
+
+/* Fixed-size object slots for FIXED_SIZE (a slot's record has size 0 while it is free) */
+
+static alloc_pt _mem_obj_alloc(pool_mgr_pt pool_mgr, size_t size) {
+    if(size > pool_mgr->obj_size || pool_mgr->obj_free_top == 0){
+        return NULL;
+    }
+
+    alloc_pt alloc = &pool_mgr->obj_rec[pool_mgr->obj_free[--pool_mgr->obj_free_top]];
+    alloc->size = pool_mgr->obj_size;
+
+    pool_mgr->pool.num_allocs++;
+    pool_mgr->pool.alloc_size += pool_mgr->obj_size;
+    pool_mgr->pool.num_gaps--;
+
+    return alloc;
+}
+
+// the slot of a handle, obj_count unless it is one of the slot records
+// (compared as integers, so a foreign pointer is never dereferenced) and
+// currently allocated
+static unsigned _mem_obj_slot(pool_mgr_pt pool_mgr, alloc_pt alloc) {
+    uintptr_t base = (uintptr_t) pool_mgr->obj_rec;
+    uintptr_t addr = (uintptr_t) alloc;
+
+    if(addr < base || addr - base >= (uintptr_t) pool_mgr->obj_count * sizeof(alloc_t) ||
+       (addr - base) % sizeof(alloc_t) != 0){
+        return pool_mgr->obj_count;
+    }
+    unsigned slot = (unsigned) ((addr - base) / sizeof(alloc_t));
+    if(pool_mgr->obj_rec[slot].size == 0){
+        return pool_mgr->obj_count;
+    }
+    return slot;
+}
+
+static alloc_status _mem_obj_free(pool_mgr_pt pool_mgr, alloc_pt alloc) {
+    unsigned slot = _mem_obj_slot(pool_mgr, alloc);
+    if(slot == pool_mgr->obj_count){
+        return ALLOC_NOT_FREED;
+    }
+
+    pool_mgr->obj_rec[slot].size = 0;
+    pool_mgr->obj_free[pool_mgr->obj_free_top++] = slot;
+
+    pool_mgr->pool.num_allocs--;
+    pool_mgr->pool.alloc_size -= pool_mgr->obj_size;
+    pool_mgr->pool.num_gaps++;
+
+    return ALLOC_OK;
+}
+
+
+/* Small-object slabs for pools opened with POOL_SMALL_SLABS */
+
+static alloc_pt _mem_slab_alloc(pool_mgr_pt pool_mgr, size_t size) {
+    unsigned cls = 0;
+    while(MEM_SLAB_CLASS_SIZE[cls] < size){
+        ++cls;
+    }
+
+    // take a slab with free objects, or carve a new one
+    slab_pt slab = pool_mgr->slab_part[cls];
+    if(slab == NULL){
+        slab = _mem_slab_new(pool_mgr, cls);
+        if(slab == NULL){
+            return NULL;
+        }
+    }
+
+    alloc_pt alloc = &slab->rec[slab->free[--slab->num_free]];
+    alloc->size = MEM_SLAB_CLASS_SIZE[cls];
+
+    // a full slab leaves the list of its class
+    if(slab->num_free == 0){
+        pool_mgr->slab_part[cls] = slab->next;
+        if(slab->next != NULL){
+            slab->next->prev = NULL;
+        }
+        slab->next = NULL;
+    }
+
+    pool_mgr->pool.num_allocs++;
+    pool_mgr->pool.alloc_size += alloc->size;
+
+    return alloc;
+}
+
+// carves a slab page out of a gap and makes it the first slab of its class
+static slab_pt _mem_slab_new(pool_mgr_pt pool_mgr, unsigned cls) {
+
+    // make room in the slab directory
+    if(pool_mgr->slab_dir_size == pool_mgr->slab_dir_capacity){
+        unsigned capacity = (pool_mgr->slab_dir_capacity == 0) ?
+                            MEM_SLAB_DIR_INIT_CAPACITY :
+                            MEM_SLAB_DIR_EXPAND_FACTOR * pool_mgr->slab_dir_capacity;
+        slab_pt *dir = (slab_pt *) realloc(pool_mgr->slab_dir, capacity * sizeof(slab_pt));
+        if(dir == NULL){
+            return NULL;
+        }
+        pool_mgr->slab_dir = dir;
+        pool_mgr->slab_dir_capacity = capacity;
+    }
+
+    unsigned num_objs = MEM_SLAB_SIZE / MEM_SLAB_CLASS_SIZE[cls];
+    slab_pt slab = (slab_pt) malloc(sizeof(slab_t) + num_objs * sizeof(alloc_t));
+    if(slab == NULL){
+        return NULL;
+    }
+    if((slab->node = _mem_carve_node(pool_mgr, MEM_SLAB_SIZE, 1)) == NULL){
+        free(slab);
+        return NULL;
+    }
+    slab->node->allocated = MEM_NODE_SLAB;
+
+    // every object starts out free, the lowest address on top of the stack
+    slab->cls = cls;
+    slab->num_objs = num_objs;
+    slab->num_free = num_objs;
+    for(unsigned u = 0; u < num_objs; ++u){
+        slab->rec[u].size = 0;
+        slab->rec[u].mem = slab->node->alloc_record.mem + u * MEM_SLAB_CLASS_SIZE[cls];
+        slab->free[u] = (unsigned char) (num_objs - 1 - u);
+    }
+
+    // insert it into the directory, keeping it sorted
+    unsigned pos = pool_mgr->slab_dir_size;
+    while(pos > 0 && (uintptr_t) pool_mgr->slab_dir[pos - 1] > (uintptr_t) slab){
+        pool_mgr->slab_dir[pos] = pool_mgr->slab_dir[pos - 1];
+        --pos;
+    }
+    pool_mgr->slab_dir[pos] = slab;
+    pool_mgr->slab_dir_size++;
+
+    slab->prev = NULL;
+    slab->next = pool_mgr->slab_part[cls];
+    if(slab->next != NULL){
+        slab->next->prev = slab;
+    }
+    pool_mgr->slab_part[cls] = slab;
+
+    return slab;
+}
+
+// the number of slabs in the directory that start at or below addr
+static unsigned _mem_slab_rank(pool_mgr_pt pool_mgr, uintptr_t addr) {
+    unsigned lo = 0, hi = pool_mgr->slab_dir_size;
+
+    while(lo < hi){
+        unsigned mid = lo + (hi - lo) / 2;
+        if((uintptr_t) pool_mgr->slab_dir[mid] <= addr){
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// maps a handle to its slab, NULL unless it is one of the object records of a
+// slab of this pool; like _mem_node_of, it only compares addresses
+static slab_pt _mem_slab_of(pool_mgr_pt pool_mgr, alloc_pt alloc) {
+    uintptr_t addr = (uintptr_t) alloc;
+
+    // the last slab that starts at or below addr
+    unsigned lo = _mem_slab_rank(pool_mgr, addr);
+    if(lo == 0){
+        return NULL;
+    }
+
+    slab_pt slab = pool_mgr->slab_dir[lo - 1];
+    uintptr_t base = (uintptr_t) slab->rec;
+    if(addr < base || addr - base >= (uintptr_t) slab->num_objs * sizeof(alloc_t) ||
+       (addr - base) % sizeof(alloc_t) != 0){
+        return NULL;
+    }
+    return slab;
+}
+
+static alloc_status _mem_slab_free(pool_mgr_pt pool_mgr, slab_pt slab, alloc_pt alloc) {
+    if(alloc->size == 0){
+        return ALLOC_NOT_FREED;
+    }
+
+    pool_mgr->pool.num_allocs--;
+    pool_mgr->pool.alloc_size -= alloc->size;
+
+    alloc->size = 0;
+    slab->free[slab->num_free++] = (unsigned char) (alloc - slab->rec);
+
+    // a slab that was full joins the list of its class again
+    if(slab->num_free == 1){
+        slab->prev = NULL;
+        slab->next = pool_mgr->slab_part[slab->cls];
+        if(slab->next != NULL){
+            slab->next->prev = slab;
+        }
+        pool_mgr->slab_part[slab->cls] = slab;
+    }
+
+    // an empty slab gives its page back, unless it is the only one of its
+    // class with free objects, which saves carving a page again right away
+    if(slab->num_free == slab->num_objs &&
+       (slab->prev != NULL || slab->next != NULL)){
+        _mem_slab_destroy(pool_mgr, slab);
+    }
+
+    return ALLOC_OK;
+}
+
+// unlinks an empty slab and turns its page back into a gap
+static void _mem_slab_destroy(pool_mgr_pt pool_mgr, slab_pt slab) {
+    assert(slab->num_free == slab->num_objs);
+
+    if(slab->prev != NULL){
+        slab->prev->next = slab->next;
+    } else {
+        pool_mgr->slab_part[slab->cls] = slab->next;
+    }
+    if(slab->next != NULL){
+        slab->next->prev = slab->prev;
+    }
+
+    unsigned pos = _mem_slab_rank(pool_mgr, (uintptr_t) slab) - 1;
+    memmove(&pool_mgr->slab_dir[pos], &pool_mgr->slab_dir[pos + 1],
+            (pool_mgr->slab_dir_size - pos - 1) * sizeof(slab_pt));
+    pool_mgr->slab_dir_size--;
+
+    slab->node->allocated = 0;
+    _mem_release_node(pool_mgr, slab->node);
+    free(slab);
+}
+
+// gives back the pages of the remaining slabs, which must all be empty
+static void _mem_slab_free_all(pool_mgr_pt pool_mgr) {
+    while(pool_mgr->slab_dir_size > 0){
+        _mem_slab_destroy(pool_mgr, pool_mgr->slab_dir[pool_mgr->slab_dir_size - 1]);
+    }
+    free(pool_mgr->slab_dir);
+    pool_mgr->slab_dir = NULL;
+    pool_mgr->slab_dir_capacity = 0;
+}
+
+
+/* Bump allocation for ARENA (each allocation record sits right before its
+ * memory; padding for alignment is a record with a NULL mem) */
+
+// the bytes taken by an allocation of size, record included
+static size_t _mem_arena_span(size_t size) {
+    return MEM_ARENA_ALIGN + (size + MEM_ARENA_ALIGN - 1) / MEM_ARENA_ALIGN * MEM_ARENA_ALIGN;
+}
+
+static alloc_pt _mem_arena_alloc(pool_mgr_pt pool_mgr, size_t size, size_t align) {
+    size_t room = pool_mgr->pool.total_size - (size_t) (pool_mgr->arena_top - pool_mgr->pool.mem);
+
+    // the padding is a multiple of MEM_ARENA_ALIGN, so it fits a record
+    size_t pad = (align > MEM_ARENA_ALIGN) ? _mem_align_pad(pool_mgr->arena_top + MEM_ARENA_ALIGN, align) : 0;
+    if(pad >= room){
+        return NULL;
+    }
+    room -= pad;
+    if(room < MEM_ARENA_ALIGN || size > room - MEM_ARENA_ALIGN ||
+       _mem_arena_span(size) > room){
+        return NULL;
+    }
+    if(pad > 0){
+        alloc_pt padding = (alloc_pt) pool_mgr->arena_top;
+        padding->size = pad - MEM_ARENA_ALIGN;
+        padding->mem = NULL;
+        pool_mgr->arena_top += pad;
+    }
+
+    alloc_pt alloc = (alloc_pt) pool_mgr->arena_top;
+    alloc->size = size;
+    alloc->mem = pool_mgr->arena_top + MEM_ARENA_ALIGN;
+    pool_mgr->arena_top += _mem_arena_span(size);
+
+    pool_mgr->pool.num_allocs++;
+    pool_mgr->pool.alloc_size += size;
+    if(pool_mgr->arena_top == pool_mgr->pool.mem + pool_mgr->pool.total_size){
+        pool_mgr->pool.num_gaps = 0;
+    }
+
+    return alloc;
+}
+
+// changes the size of the allocation at the top of the arena in place,
+// ALLOC_FAIL for any other allocation or if the arena is too small
+static alloc_status _mem_arena_resize(pool_mgr_pt pool_mgr, alloc_pt alloc, size_t size) {
+    char *rec = (char *) alloc;
+
+    // a record made before the latest mark keeps its size, so that the mark
+    // stays at the end of a record
+    if(rec < pool_mgr->arena_mark || rec >= pool_mgr->arena_top ||
+       (size_t) (rec - pool_mgr->pool.mem) % MEM_ARENA_ALIGN != 0 ||
+       rec + _mem_arena_span(alloc->size) != pool_mgr->arena_top){
+        return ALLOC_FAIL;
+    }
+
+    size_t room = pool_mgr->pool.total_size - (size_t) (rec - pool_mgr->pool.mem);
+    if(size > room - MEM_ARENA_ALIGN || _mem_arena_span(size) > room){
+        return ALLOC_FAIL;
+    }
+
+    pool_mgr->arena_top = rec + _mem_arena_span(size);
+    pool_mgr->pool.alloc_size = pool_mgr->pool.alloc_size - alloc->size + size;
+    pool_mgr->pool.num_gaps = (pool_mgr->arena_top < pool_mgr->pool.mem + pool_mgr->pool.total_size);
+    alloc->size = size;
+
+    return ALLOC_OK;
+}
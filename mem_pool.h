@@ -9,7 +9,15 @@
 
 /* type declarations */
 
-typedef enum _alloc_policy { FIRST_FIT, BEST_FIT } alloc_policy;
+typedef enum _alloc_policy { FIRST_FIT, BEST_FIT, SEGREGATED_FIT, TLSF, BUDDY, NEXT_FIT, WORST_FIT, FIXED_SIZE, ARENA } alloc_policy;
+
+// options for mem_pool_open_ex, or-ed together
+typedef enum _pool_flags {
+    POOL_SMALL_SLABS = 0x1, // serve small requests from size-class slabs
+    POOL_GROWABLE    = 0x2, // add memory to the pool when no gap fits a request
+    POOL_HUGE_PAGES  = 0x4, // back the pool with 2 MiB pages where the system has them
+    POOL_PREFAULT    = 0x8  // populate the pool's pages at open instead of on first use
+} pool_flags;
 
 typedef struct _pool {
     char *mem;
@@ -18,6 +26,7 @@ typedef struct _pool {
     size_t alloc_size;
     unsigned num_allocs;
     unsigned num_gaps;
+    unsigned long long prefault_ns; // POOL_PREFAULT: time spent populating the pool
 } pool_t, *pool_pt;
 
 typedef struct _alloc {
@@ -30,6 +39,15 @@ typedef struct _pool_segment {
     unsigned long allocated; // 1-allocation, 0-gap (note: 8 bytes)
 } pool_segment_t, *pool_segment_pt;
 
+// a saved arena top, see mem_pool_mark
+typedef struct _pool_mark {
+    size_t top;
+    size_t alloc_size;
+    unsigned num_allocs;
+    unsigned depth; // its place in the pool's stack of marks, from 1
+    size_t seq;     // tells it from marks taken at the same depth before
+} pool_mark_t, *pool_mark_pt;
+
 typedef enum _alloc_status {
     ALLOC_OK,
     ALLOC_FAIL,
@@ -48,15 +66,45 @@ mem_free();
 pool_pt
 mem_pool_open(size_t size, alloc_policy policy);
 
+pool_pt
+mem_pool_open_ex(size_t size, alloc_policy policy, unsigned flags);
+
+pool_pt
+mem_obj_pool_open(size_t obj_size, unsigned count);
+
 alloc_status
 mem_pool_close(pool_pt pool);
 
+alloc_status
+mem_pool_reset(pool_pt pool);
+
+alloc_status
+mem_pool_resize(pool_pt pool, size_t new_size);
+
+pool_mark_t
+mem_pool_mark(pool_pt pool);
+
+alloc_status
+mem_pool_rollback(pool_pt pool, pool_mark_t mark);
+
 alloc_pt
 mem_new_alloc(pool_pt pool, size_t size);
 
+alloc_pt
+mem_new_alloc_aligned(pool_pt pool, size_t size, size_t align);
+
+alloc_pt
+mem_realloc_alloc(pool_pt pool, alloc_pt alloc, size_t new_size);
+
+alloc_status
+mem_new_alloc_batch(pool_pt pool, const size_t *sizes, size_t n, alloc_pt *out);
+
 alloc_status
 mem_del_alloc(pool_pt pool, alloc_pt alloc);
 
+alloc_status
+mem_del_alloc_batch(pool_pt pool, alloc_pt *allocs, size_t n);
+
 void
 mem_inspect_pool(pool_pt pool, pool_segment_pt *segments, unsigned *num_segments);
 
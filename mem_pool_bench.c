@@ -0,0 +1,1032 @@
+//
+// Benchmarks for the mem_pool library. Not part of the test suite.
+//
+
+#define _POSIX_C_SOURCE 200809L // for clock_gettime()
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mem_pool.h"
+
+
+/*****            constants            *****/
+
+static const unsigned BENCH_NUM_PROBES    = 10000;
+static const size_t   BENCH_MIN_SIZE      = 16;
+static const unsigned BENCH_NUM_GROWTH    = 1 << 20;
+static const unsigned BENCH_NUM_FREES     = 1 << 14;
+static const unsigned BENCH_NUM_BUFFERS   = 4000;
+static const unsigned BENCH_NUM_MESSAGES  = 200000;
+static const size_t   BENCH_SLIVER_SIZE   = 64;
+static const unsigned BENCH_NUM_SMALL     = 1 << 17;
+static const unsigned BENCH_NUM_REQUESTS  = 2000;
+static const unsigned BENCH_NUM_SCRATCH   = 500;
+static const unsigned BENCH_NUM_LEVELS    = 8;
+static const unsigned BENCH_NUM_GROW_STEPS = 2000;
+static const unsigned BENCH_NUM_BATCHES   = 2000;
+static const unsigned BENCH_BATCH_SIZE    = 256;
+static const unsigned BENCH_NUM_TEARDOWN  = 100000;
+static const unsigned BENCH_NUM_CYCLES    = 20000;
+static const size_t   BENCH_TLB_POOL_SIZE = (size_t) 1 << 30;
+static const unsigned BENCH_NUM_ACCESSES  = 1 << 24;
+static const size_t   BENCH_PREFAULT_POOL_SIZE = (size_t) 256 << 20;
+static const size_t   BENCH_REQUEST_SIZE  = (size_t) 1 << 20;
+
+
+/*****         helper routines         *****/
+
+static const char *policy_name(alloc_policy policy) {
+    switch (policy) {
+        case FIRST_FIT:      return "FIRST_FIT";
+        case BEST_FIT:       return "BEST_FIT";
+        case SEGREGATED_FIT: return "SEGREGATED_FIT";
+        case TLSF:           return "TLSF";
+        case BUDDY:          return "BUDDY";
+        case NEXT_FIT:       return "NEXT_FIT";
+        case WORST_FIT:      return "WORST_FIT";
+        case FIXED_SIZE:     return "FIXED_SIZE";
+        case ARENA:          return "ARENA";
+    }
+    return "?";
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ll(const void *a, const void *b) {
+    long long x = *(const long long *) a;
+    long long y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Lays out num_gaps holes between spacer allocations. The holes grow by one
+ * byte each, from BENCH_MIN_SIZE to BENCH_MIN_SIZE + num_gaps - 1, and the
+ * spacers are bigger than any hole, so nothing lands in an earlier hole.
+ */
+static pool_pt fragmented_pool(alloc_policy policy, unsigned num_gaps) {
+    size_t spacer_size = BENCH_MIN_SIZE + num_gaps;
+    size_t pool_size = (size_t) num_gaps * (BENCH_MIN_SIZE + num_gaps + spacer_size) + spacer_size;
+    pool_pt pool = mem_pool_open(pool_size, policy);
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    for (unsigned u = 0; u < num_gaps; ++u) {
+        alloc_pt hole = mem_new_alloc(pool, BENCH_MIN_SIZE + u);
+        alloc_pt spacer = mem_new_alloc(pool, spacer_size);
+        if (hole == NULL || spacer == NULL) {
+            break;
+        }
+        mem_del_alloc(pool, hole);
+    }
+    return pool;
+}
+
+/*
+ * Number of gaps a list scan starting at from passes before it reaches the
+ * segment at target, wrapping around the end of the pool.
+ */
+static unsigned search_length(pool_pt pool, const char *from, const char *target) {
+    pool_segment_pt segs = NULL;
+    unsigned num_segs = 0, length = 0;
+    const char *mem = pool->mem;
+
+    mem_inspect_pool(pool, &segs, &num_segs);
+    for (unsigned u = 0; u < num_segs; ++u) {
+        int passed = (from <= target) ? (mem >= from && mem < target)
+                                      : (mem >= from || mem < target);
+        if (passed && !segs[u].allocated) {
+            ++length;
+        }
+        mem += segs[u].size;
+    }
+    free(segs);
+    return length;
+}
+
+
+/*****           benchmarks            *****/
+
+/*
+ * Worst-case allocation latency as the number of gaps grows.
+ *
+ * Each probe allocates a random size that fits one of the holes and
+ * immediately frees it, so the layout is the same for every probe.
+ */
+static void bench_gap_latency(void) {
+    const alloc_policy policies[] = { FIRST_FIT, BEST_FIT, SEGREGATED_FIT, TLSF, BUDDY, NEXT_FIT, WORST_FIT };
+    const unsigned gap_counts[] = { 256, 1024, 4096, 16384 };
+    long long *samples = (long long *) calloc(BENCH_NUM_PROBES, sizeof(long long));
+
+    printf("gap_latency: alloc + free of a block that fits a random hole (ns)\n");
+    printf("%-15s %8s %8s %10s %10s %10s\n", "policy", "gaps", "median", "p99", "p99.9", "max");
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        for (unsigned g = 0; g < sizeof(gap_counts) / sizeof(gap_counts[0]); ++g) {
+            srand(1);
+            mem_init();
+            pool_pt pool = fragmented_pool(policies[p], gap_counts[g]);
+            unsigned num_gaps = pool->num_gaps;
+
+            for (unsigned u = 0; u < BENCH_NUM_PROBES; ++u) {
+                size_t size = BENCH_MIN_SIZE + (size_t) rand() % gap_counts[g];
+                long long start = now_ns();
+                alloc_pt alloc = mem_new_alloc(pool, size);
+                if (alloc) {
+                    mem_del_alloc(pool, alloc);
+                }
+                samples[u] = now_ns() - start;
+            }
+            qsort(samples, BENCH_NUM_PROBES, sizeof(long long), cmp_ll);
+
+            printf("%-15s %8u %8lld %10lld %10lld %10lld\n",
+                   policy_name(policies[p]), num_gaps,
+                   samples[BENCH_NUM_PROBES / 2],
+                   samples[BENCH_NUM_PROBES * 99 / 100],
+                   samples[BENCH_NUM_PROBES * 999 / 1000],
+                   samples[BENCH_NUM_PROBES - 1]);
+
+            // the pool still holds the spacers, mem_free releases the store regardless
+            mem_free();
+        }
+    }
+    printf("\n");
+
+    free(samples);
+}
+
+
+/*
+ * Allocation latency while the node heap keeps growing.
+ *
+ * A fresh pool takes BENCH_NUM_GROWTH small allocations in a row, so every
+ * one of them needs a new node and the node heap grows many times over.
+ */
+static void bench_node_growth(void) {
+    const alloc_policy policies[] = { BEST_FIT, TLSF };
+    long long *samples = (long long *) calloc(BENCH_NUM_GROWTH, sizeof(long long));
+
+    printf("node_growth: %u allocations into a fresh pool (ns)\n", BENCH_NUM_GROWTH);
+    printf("%-15s %8s %10s %10s %10s\n", "policy", "median", "p99", "p99.99", "max");
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        mem_init();
+        pool_pt pool = mem_pool_open((size_t) BENCH_NUM_GROWTH * BENCH_MIN_SIZE + 1, policies[p]);
+
+        for (unsigned u = 0; u < BENCH_NUM_GROWTH; ++u) {
+            long long start = now_ns();
+            mem_new_alloc(pool, BENCH_MIN_SIZE);
+            samples[u] = now_ns() - start;
+        }
+        qsort(samples, BENCH_NUM_GROWTH, sizeof(long long), cmp_ll);
+
+        printf("%-15s %8lld %10lld %10lld %10lld\n",
+               policy_name(policies[p]),
+               samples[BENCH_NUM_GROWTH / 2],
+               samples[BENCH_NUM_GROWTH / 100 * 99],
+               samples[BENCH_NUM_GROWTH / 10000 * 9999],
+               samples[BENCH_NUM_GROWTH - 1]);
+
+        mem_free();
+    }
+    printf("\n");
+
+    free(samples);
+}
+
+
+/*
+ * Deallocation cost when frees coalesce.
+ *
+ * Like test_pool_stresstest, a pool is filled with allocations of growing
+ * sizes and every other one is freed, which leaves a gap between each pair
+ * of allocations. Freeing the rest then merges every one with a gap on
+ * both sides. Each pass is repeated on the same layout.
+ */
+static void bench_free_heavy(void) {
+    const alloc_policy policies[] = { FIRST_FIT, BEST_FIT, SEGREGATED_FIT, TLSF, BUDDY, NEXT_FIT, WORST_FIT };
+    const unsigned num_rounds = 5;
+    alloc_pt *allocs = (alloc_pt *) calloc(BENCH_NUM_FREES, sizeof(alloc_pt));
+
+    printf("free_heavy: %u allocations, free every other, then the rest (ns per free)\n", BENCH_NUM_FREES);
+    printf("%-15s %12s %12s\n", "policy", "no merge", "both merge");
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        long long no_merge = 0, both_merge = 0;
+
+        mem_init();
+        pool_pt pool = mem_pool_open((size_t) BENCH_NUM_FREES * (BENCH_MIN_SIZE + BENCH_NUM_FREES), policies[p]);
+
+        for (unsigned r = 0; r < num_rounds; ++r) {
+            for (unsigned u = 0; u < BENCH_NUM_FREES; ++u) {
+                allocs[u] = mem_new_alloc(pool, BENCH_MIN_SIZE + u);
+            }
+
+            long long start = now_ns();
+            for (unsigned u = 1; u < BENCH_NUM_FREES; u += 2) {
+                mem_del_alloc(pool, allocs[u]);
+            }
+            no_merge += now_ns() - start;
+
+            start = now_ns();
+            for (unsigned u = 0; u < BENCH_NUM_FREES; u += 2) {
+                mem_del_alloc(pool, allocs[u]);
+            }
+            both_merge += now_ns() - start;
+        }
+
+        printf("%-15s %12lld %12lld\n",
+               policy_name(policies[p]),
+               no_merge / (num_rounds * BENCH_NUM_FREES / 2),
+               both_merge / (num_rounds * BENCH_NUM_FREES / 2));
+
+        mem_pool_close(pool);
+        mem_free();
+    }
+    printf("\n");
+
+    free(allocs);
+}
+
+
+/*
+ * Search length on a sequential allocation pattern.
+ *
+ * The pool starts with a prefix of small holes that no buffer fits, then
+ * takes BENCH_NUM_BUFFERS similar buffers in a row, freeing the oldest once
+ * 500 are live. The search length of an allocation is the number of gaps a
+ * list scan from its starting point passes: the start of the pool for
+ * FIRST_FIT, the end of the previous allocation for NEXT_FIT.
+ */
+static void bench_next_fit(void) {
+    const alloc_policy policies[] = { FIRST_FIT, NEXT_FIT };
+    const unsigned num_holes = 1000, num_live = 500;
+    alloc_pt *live = (alloc_pt *) calloc(num_live, sizeof(alloc_pt));
+    alloc_pt *holes = (alloc_pt *) calloc(num_holes, sizeof(alloc_pt));
+
+    printf("next_fit: %u buffers of 200-255 bytes after %u small holes\n", BENCH_NUM_BUFFERS, num_holes);
+    printf("%-15s %12s %12s %10s %10s\n", "policy", "avg search", "max search", "avg ns", "max ns");
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        unsigned long long total_length = 0;
+        unsigned max_length = 0;
+        long long total_ns = 0, max_ns = 0;
+        const char *from = NULL;
+
+        srand(1);
+        mem_init();
+        pool_pt pool = mem_pool_open(1 << 20, policies[p]);
+        for (unsigned u = 0; u < num_holes; ++u) {
+            holes[u] = mem_new_alloc(pool, BENCH_MIN_SIZE);
+            mem_new_alloc(pool, BENCH_MIN_SIZE);
+        }
+        for (unsigned u = 0; u < num_holes; ++u) {
+            mem_del_alloc(pool, holes[u]);
+        }
+        from = pool->mem + 2 * num_holes * BENCH_MIN_SIZE;
+        memset(live, 0, num_live * sizeof(alloc_pt));
+
+        for (unsigned u = 0; u < BENCH_NUM_BUFFERS; ++u) {
+            unsigned slot = u % num_live;
+            if (live[slot]) {
+                mem_del_alloc(pool, live[slot]);
+            }
+
+            size_t size = 200 + (size_t) rand() % 56;
+            long long start = now_ns();
+            live[slot] = mem_new_alloc(pool, size);
+            long long ns = now_ns() - start;
+
+            unsigned length = search_length(pool, (policies[p] == NEXT_FIT) ? from : pool->mem, live[slot]->mem);
+            from = live[slot]->mem + size;
+
+            total_length += length;
+            total_ns += ns;
+            if (length > max_length) max_length = length;
+            if (ns > max_ns) max_ns = ns;
+        }
+
+        printf("%-15s %12.1f %12u %10lld %10lld\n",
+               policy_name(policies[p]),
+               (double) total_length / BENCH_NUM_BUFFERS, max_length,
+               total_ns / BENCH_NUM_BUFFERS, max_ns);
+
+        mem_free();
+    }
+    printf("\n");
+
+    free(live);
+    free(holes);
+}
+
+
+/*
+ * Fragmentation under variable-size message buffers.
+ *
+ * BENCH_NUM_MESSAGES random operations on a 4 MB pool: while fewer than
+ * 1500 buffers of 64-4096 bytes are live, 60% of the operations allocate one,
+ * the rest free a random live buffer. The final layout is reported as the
+ * number of gaps, the gaps smaller than BENCH_SLIVER_SIZE (slivers), the
+ * largest gap, and how much of the free space lies outside it.
+ */
+static void bench_fragmentation(void) {
+    const alloc_policy policies[] = { FIRST_FIT, NEXT_FIT, BEST_FIT, WORST_FIT };
+    const unsigned max_live = 1500;
+    alloc_pt *live = (alloc_pt *) calloc(max_live, sizeof(alloc_pt));
+
+    printf("fragmentation: %u random allocs/frees of 64-4096 bytes in 4 MB\n", BENCH_NUM_MESSAGES);
+    printf("%-15s %8s %8s %10s %10s %8s\n", "policy", "gaps", "slivers", "largest", "frag %", "failed");
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        unsigned num_live = 0, failed = 0, slivers = 0;
+        size_t largest = 0;
+
+        srand(1);
+        mem_init();
+        pool_pt pool = mem_pool_open(4 << 20, policies[p]);
+
+        for (unsigned u = 0; u < BENCH_NUM_MESSAGES; ++u) {
+            if (num_live < max_live && (num_live == 0 || rand() % 10 < 6)) {
+                alloc_pt alloc = mem_new_alloc(pool, 64 + (size_t) rand() % 4033);
+                if (alloc) {
+                    live[num_live++] = alloc;
+                } else {
+                    ++failed;
+                }
+            } else {
+                unsigned victim = (unsigned) rand() % num_live;
+                mem_del_alloc(pool, live[victim]);
+                live[victim] = live[--num_live];
+            }
+        }
+
+        pool_segment_pt segs = NULL;
+        unsigned num_segs = 0;
+        mem_inspect_pool(pool, &segs, &num_segs);
+        for (unsigned u = 0; u < num_segs; ++u) {
+            if (segs[u].allocated) continue;
+            if (segs[u].size < BENCH_SLIVER_SIZE) ++slivers;
+            if (segs[u].size > largest) largest = segs[u].size;
+        }
+        free(segs);
+
+        size_t free_size = pool->total_size - pool->alloc_size;
+        printf("%-15s %8u %8u %10zu %10.1f %8u\n",
+               policy_name(policies[p]), pool->num_gaps, slivers, largest,
+               100.0 * (double) (free_size - largest) / (double) free_size, failed);
+
+        mem_free();
+    }
+    printf("\n");
+
+    free(live);
+}
+
+
+/*
+ * Small-object traffic with and without slabs.
+ *
+ * BENCH_NUM_SMALL allocations of 16-256 bytes fill a fresh pool and are
+ * then freed in random order. The segments column counts the pool's nodes
+ * while all of them are live; with slabs most of the objects share the
+ * node of a slab page.
+ */
+static void bench_small_objects(void) {
+    const alloc_policy policies[] = { BEST_FIT, TLSF };
+    const unsigned flags[] = { 0, POOL_SMALL_SLABS };
+    alloc_pt *live = (alloc_pt *) calloc(BENCH_NUM_SMALL, sizeof(alloc_pt));
+
+    printf("small_objects: %u allocations of 16-256 bytes, freed in random order\n", BENCH_NUM_SMALL);
+    printf("%-15s %6s %10s %10s %10s\n", "policy", "slabs", "alloc ns", "free ns", "segments");
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        for (unsigned f = 0; f < sizeof(flags) / sizeof(flags[0]); ++f) {
+            srand(1);
+            mem_init();
+            pool_pt pool = mem_pool_open_ex((size_t) BENCH_NUM_SMALL * 512, policies[p], flags[f]);
+
+            long long start = now_ns();
+            for (unsigned u = 0; u < BENCH_NUM_SMALL; ++u) {
+                live[u] = mem_new_alloc(pool, 16 + (size_t) rand() % 241);
+            }
+            long long alloc_ns = now_ns() - start;
+
+            pool_segment_pt segs = NULL;
+            unsigned num_segs = 0;
+            mem_inspect_pool(pool, &segs, &num_segs);
+            free(segs);
+
+            for (unsigned u = BENCH_NUM_SMALL - 1; u > 0; --u) {
+                unsigned v = (unsigned) rand() % (u + 1);
+                alloc_pt tmp = live[u];
+                live[u] = live[v];
+                live[v] = tmp;
+            }
+            start = now_ns();
+            for (unsigned u = 0; u < BENCH_NUM_SMALL; ++u) {
+                mem_del_alloc(pool, live[u]);
+            }
+            long long free_ns = now_ns() - start;
+
+            printf("%-15s %6s %10.1f %10.1f %10u\n",
+                   policy_name(policies[p]), flags[f] ? "yes" : "no",
+                   (double) alloc_ns / BENCH_NUM_SMALL, (double) free_ns / BENCH_NUM_SMALL, num_segs);
+
+            mem_free();
+        }
+    }
+    printf("\n");
+
+    free(live);
+}
+
+
+/*
+ * Request-scoped scratch memory.
+ *
+ * Each of BENCH_NUM_REQUESTS requests makes BENCH_NUM_SCRATCH allocations
+ * of 16-512 bytes and then drops them all: one by one with mem_del_alloc,
+ * or with a single mem_pool_reset for an arena.
+ */
+static void bench_arena(void) {
+    const alloc_policy policies[] = { FIRST_FIT, BEST_FIT, TLSF, ARENA };
+    alloc_pt *live = (alloc_pt *) calloc(BENCH_NUM_SCRATCH, sizeof(alloc_pt));
+
+    printf("arena: %u requests of %u allocations of 16-512 bytes (ns per allocation)\n",
+           BENCH_NUM_REQUESTS, BENCH_NUM_SCRATCH);
+    printf("%-15s %10s %10s\n", "policy", "alloc", "release");
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        long long alloc_ns = 0, release_ns = 0;
+
+        srand(1);
+        mem_init();
+        pool_pt pool = mem_pool_open((size_t) BENCH_NUM_SCRATCH * 1024, policies[p]);
+
+        for (unsigned r = 0; r < BENCH_NUM_REQUESTS; ++r) {
+            long long start = now_ns();
+            for (unsigned u = 0; u < BENCH_NUM_SCRATCH; ++u) {
+                live[u] = mem_new_alloc(pool, 16 + (size_t) rand() % 497);
+            }
+            long long mid = now_ns();
+            if (policies[p] == ARENA) {
+                mem_pool_reset(pool);
+            } else {
+                for (unsigned u = 0; u < BENCH_NUM_SCRATCH; ++u) {
+                    mem_del_alloc(pool, live[u]);
+                }
+            }
+            release_ns += now_ns() - mid;
+            alloc_ns += mid - start;
+        }
+
+        printf("%-15s %10.1f %10.1f\n", policy_name(policies[p]),
+               (double) alloc_ns / BENCH_NUM_REQUESTS / BENCH_NUM_SCRATCH,
+               (double) release_ns / BENCH_NUM_REQUESTS / BENCH_NUM_SCRATCH);
+
+        mem_free();
+    }
+    printf("\n");
+
+    free(live);
+}
+
+
+/*
+ * Nested phases that drop a whole level at a time.
+ *
+ * Each of BENCH_NUM_REQUESTS parses opens BENCH_NUM_LEVELS levels, and each
+ * level makes BENCH_NUM_SCRATCH / BENCH_NUM_LEVELS allocations of 16-512
+ * bytes. The levels are then dropped innermost first: one allocation at a
+ * time with mem_del_alloc, or with mem_pool_rollback to the level's mark.
+ */
+static void bench_rollback(void) {
+    const alloc_policy policies[] = { FIRST_FIT, TLSF, ARENA };
+    const unsigned per_level = BENCH_NUM_SCRATCH / BENCH_NUM_LEVELS;
+    alloc_pt *live = (alloc_pt *) calloc(BENCH_NUM_SCRATCH, sizeof(alloc_pt));
+    pool_mark_t marks[BENCH_NUM_LEVELS];
+
+    printf("rollback: %u parses of %u levels of %u allocations (ns per dropped level)\n",
+           BENCH_NUM_REQUESTS, BENCH_NUM_LEVELS, per_level);
+    printf("%-15s %10s\n", "policy", "drop");
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        long long drop_ns = 0;
+
+        srand(1);
+        mem_init();
+        pool_pt pool = mem_pool_open((size_t) BENCH_NUM_SCRATCH * 1024, policies[p]);
+
+        for (unsigned r = 0; r < BENCH_NUM_REQUESTS; ++r) {
+            for (unsigned l = 0; l < BENCH_NUM_LEVELS; ++l) {
+                marks[l] = mem_pool_mark(pool);
+                for (unsigned u = 0; u < per_level; ++u) {
+                    live[l * per_level + u] = mem_new_alloc(pool, 16 + (size_t) rand() % 497);
+                }
+            }
+            for (unsigned l = BENCH_NUM_LEVELS; l-- > 0; ) {
+                long long start = now_ns();
+                if (policies[p] == ARENA) {
+                    mem_pool_rollback(pool, marks[l]);
+                } else {
+                    for (unsigned u = per_level; u-- > 0; ) {
+                        mem_del_alloc(pool, live[l * per_level + u]);
+                    }
+                }
+                drop_ns += now_ns() - start;
+            }
+        }
+
+        printf("%-15s %10.1f\n", policy_name(policies[p]),
+               (double) drop_ns / BENCH_NUM_REQUESTS / BENCH_NUM_LEVELS);
+
+        mem_free();
+    }
+    printf("\n");
+
+    free(live);
+}
+
+
+/*
+ * Aligned buffers.
+ *
+ * BENCH_NUM_BUFFERS buffers of 64-4096 bytes are allocated with each
+ * alignment, either with mem_new_alloc_aligned or by over-allocating
+ * align - 1 bytes and rounding the address up. The overhead is the pool
+ * space below the last buffer that is not requested memory.
+ */
+static void bench_aligned(void) {
+    const alloc_policy policies[] = { FIRST_FIT, TLSF };
+    const size_t aligns[] = { 64, 4096 };
+
+    printf("aligned: %u buffers of 64-4096 bytes\n", BENCH_NUM_BUFFERS);
+    printf("%-15s %6s %10s %10s %14s\n", "policy", "align", "api", "alloc ns", "overhead/buf");
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        for (unsigned a = 0; a < sizeof(aligns) / sizeof(aligns[0]); ++a) {
+            for (int api = 0; api < 2; ++api) {
+                size_t requested = 0;
+                char *end = NULL;
+
+                srand(1);
+                mem_init();
+                pool_pt pool = mem_pool_open((size_t) BENCH_NUM_BUFFERS * 2 * 8192, policies[p]);
+
+                long long start = now_ns();
+                for (unsigned u = 0; u < BENCH_NUM_BUFFERS; ++u) {
+                    size_t size = 64 + (size_t) rand() % 4033;
+                    alloc_pt alloc = api ?
+                                     mem_new_alloc_aligned(pool, size, aligns[a]) :
+                                     mem_new_alloc(pool, size + aligns[a] - 1);
+                    requested += size;
+                    if (alloc->mem + alloc->size > end) end = alloc->mem + alloc->size;
+                }
+                long long alloc_ns = now_ns() - start;
+
+                printf("%-15s %6zu %10s %10.1f %14.1f\n",
+                       policy_name(policies[p]), aligns[a], api ? "aligned" : "over",
+                       (double) alloc_ns / BENCH_NUM_BUFFERS,
+                       (double) ((size_t) (end - pool->mem) - requested) / BENCH_NUM_BUFFERS);
+
+                mem_free();
+            }
+        }
+    }
+    printf("\n");
+}
+
+/*
+ * A few buffers grown in 64-byte steps, with a small allocation made
+ * every so often in between, the way a parser grows its token and
+ * output buffers. Each step is either a mem_realloc_alloc or the
+ * alloc + copy + free that a caller had to write before it.
+ */
+static void bench_realloc(void) {
+    const alloc_policy policies[] = { FIRST_FIT, BEST_FIT, TLSF };
+    enum { NUM_BUFS = 4 };
+
+    printf("realloc: %u buffers grown in %u steps of 64 bytes\n", NUM_BUFS, BENCH_NUM_GROW_STEPS);
+    printf("%-15s %10s %10s %10s\n", "policy", "api", "step ns", "moved %");
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        for (int api = 0; api < 2; ++api) {
+            alloc_pt bufs[NUM_BUFS];
+            unsigned moved = 0;
+
+            srand(1);
+            mem_init();
+            pool_pt pool = mem_pool_open((size_t) NUM_BUFS * BENCH_NUM_GROW_STEPS * 64 * 4, policies[p]);
+            for (unsigned b = 0; b < NUM_BUFS; ++b) bufs[b] = mem_new_alloc(pool, 64);
+
+            long long start = now_ns();
+            for (unsigned u = 0; u < BENCH_NUM_GROW_STEPS; ++u) {
+                for (unsigned b = 0; b < NUM_BUFS; ++b) {
+                    size_t size = bufs[b]->size + 64;
+                    alloc_pt grown;
+                    if (api) {
+                        grown = mem_realloc_alloc(pool, bufs[b], size);
+                    } else {
+                        grown = mem_new_alloc(pool, size);
+                        memcpy(grown->mem, bufs[b]->mem, bufs[b]->size);
+                        mem_del_alloc(pool, bufs[b]);
+                    }
+                    if (grown->mem != bufs[b]->mem) ++moved;
+                    bufs[b] = grown;
+                }
+                if (rand() % 8 == 0) mem_new_alloc(pool, 16 + (size_t) rand() % 112);
+            }
+            long long step_ns = now_ns() - start;
+
+            printf("%-15s %10s %10.1f %10.1f\n",
+                   policy_name(policies[p]), api ? "realloc" : "copy",
+                   (double) step_ns / (NUM_BUFS * BENCH_NUM_GROW_STEPS),
+                   100.0 * moved / (NUM_BUFS * BENCH_NUM_GROW_STEPS));
+
+            mem_free();
+        }
+    }
+    printf("\n");
+}
+
+/*
+ * Message batches of BENCH_BATCH_SIZE buffers, allocated one call per
+ * buffer or with one mem_new_alloc_batch, into a pool fragmented by a
+ * long-lived allocation left behind after every batch.
+ */
+static void bench_batch(void) {
+    const alloc_policy policies[] = { FIRST_FIT, BEST_FIT, TLSF };
+
+    printf("batch: %u batches of %u buffers of 64-1024 bytes\n", BENCH_NUM_BATCHES, BENCH_BATCH_SIZE);
+    printf("%-15s %10s %10s %10s\n", "policy", "api", "alloc ns", "gaps");
+
+    size_t *sizes = malloc(BENCH_BATCH_SIZE * sizeof(size_t));
+    alloc_pt *batch = malloc(BENCH_BATCH_SIZE * sizeof(alloc_pt));
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        for (int api = 0; api < 2; ++api) {
+            long long alloc_ns = 0;
+
+            srand(1);
+            mem_init();
+            pool_pt pool = mem_pool_open((size_t) BENCH_BATCH_SIZE * 1024 * 4 + BENCH_NUM_BATCHES * 64, policies[p]);
+
+            for (unsigned b = 0; b < BENCH_NUM_BATCHES; ++b) {
+                for (unsigned u = 0; u < BENCH_BATCH_SIZE; ++u) {
+                    sizes[u] = 64 + (size_t) rand() % 961;
+                }
+
+                long long start = now_ns();
+                if (api) {
+                    mem_new_alloc_batch(pool, sizes, BENCH_BATCH_SIZE, batch);
+                } else {
+                    for (unsigned u = 0; u < BENCH_BATCH_SIZE; ++u) {
+                        batch[u] = mem_new_alloc(pool, sizes[u]);
+                    }
+                }
+                alloc_ns += now_ns() - start;
+
+                // a message of the batch outlives it
+                mem_new_alloc(pool, 16 + (size_t) rand() % 48);
+                for (unsigned u = 0; u < BENCH_BATCH_SIZE; ++u) {
+                    mem_del_alloc(pool, batch[u]);
+                }
+            }
+
+            printf("%-15s %10s %10.1f %10u\n",
+                   policy_name(policies[p]), api ? "batch" : "single",
+                   (double) alloc_ns / ((double) BENCH_NUM_BATCHES * BENCH_BATCH_SIZE),
+                   pool->num_gaps);
+
+            mem_free();
+        }
+    }
+
+    free(sizes);
+    free(batch);
+    printf("\n");
+}
+
+/*
+ * Tearing down BENCH_NUM_TEARDOWN allocations, freed in random order one
+ * call at a time or with one mem_del_alloc_batch.
+ */
+static void bench_teardown(void) {
+    const alloc_policy policies[] = { FIRST_FIT, BEST_FIT, TLSF };
+
+    printf("teardown: %u allocations of 16-256 bytes in random order\n", BENCH_NUM_TEARDOWN);
+    printf("%-15s %10s %10s\n", "policy", "api", "free ns");
+
+    alloc_pt *allocs = malloc(BENCH_NUM_TEARDOWN * sizeof(alloc_pt));
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        for (int api = 0; api < 2; ++api) {
+            srand(1);
+            mem_init();
+            pool_pt pool = mem_pool_open((size_t) BENCH_NUM_TEARDOWN * 256, policies[p]);
+
+            for (unsigned u = 0; u < BENCH_NUM_TEARDOWN; ++u) {
+                allocs[u] = mem_new_alloc(pool, 16 + (size_t) rand() % 241);
+            }
+            for (unsigned u = BENCH_NUM_TEARDOWN - 1; u > 0; --u) {
+                unsigned v = (unsigned) rand() % (u + 1);
+                alloc_pt tmp = allocs[u];
+                allocs[u] = allocs[v];
+                allocs[v] = tmp;
+            }
+
+            long long start = now_ns();
+            if (api) {
+                mem_del_alloc_batch(pool, allocs, BENCH_NUM_TEARDOWN);
+            } else {
+                for (unsigned u = 0; u < BENCH_NUM_TEARDOWN; ++u) {
+                    mem_del_alloc(pool, allocs[u]);
+                }
+            }
+            long long free_ns = now_ns() - start;
+
+            printf("%-15s %10s %10.1f\n",
+                   policy_name(policies[p]), api ? "batch" : "single",
+                   (double) free_ns / BENCH_NUM_TEARDOWN);
+
+            mem_free();
+        }
+    }
+
+    free(allocs);
+    printf("\n");
+}
+
+/*
+ * A batch job that recycles its pool BENCH_NUM_CYCLES times, each time
+ * after BENCH_NUM_SCRATCH allocations: either deallocating them all and
+ * opening the pool anew, or resetting it.
+ */
+static void bench_recycle(void) {
+    const alloc_policy policies[] = { FIRST_FIT, BEST_FIT, TLSF };
+    const size_t pool_size = (size_t) BENCH_NUM_SCRATCH * 256;
+
+    printf("recycle: %u cycles of %u allocations of 16-256 bytes\n", BENCH_NUM_CYCLES, BENCH_NUM_SCRATCH);
+    printf("%-15s %10s %10s\n", "policy", "api", "cycle ns");
+
+    alloc_pt *allocs = malloc(BENCH_NUM_SCRATCH * sizeof(alloc_pt));
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        for (int api = 0; api < 2; ++api) {
+            long long recycle_ns = 0;
+
+            srand(1);
+            mem_init();
+            pool_pt pool = mem_pool_open(pool_size, policies[p]);
+
+            for (unsigned c = 0; c < BENCH_NUM_CYCLES; ++c) {
+                for (unsigned u = 0; u < BENCH_NUM_SCRATCH; ++u) {
+                    allocs[u] = mem_new_alloc(pool, 16 + (size_t) rand() % 241);
+                }
+
+                long long start = now_ns();
+                if (api) {
+                    mem_pool_reset(pool);
+                } else {
+                    for (unsigned u = 0; u < BENCH_NUM_SCRATCH; ++u) {
+                        mem_del_alloc(pool, allocs[u]);
+                    }
+                    mem_pool_close(pool);
+                    pool = mem_pool_open(pool_size, policies[p]);
+                }
+                recycle_ns += now_ns() - start;
+            }
+
+            printf("%-15s %10s %10.1f\n",
+                   policy_name(policies[p]), api ? "reset" : "reopen",
+                   (double) recycle_ns / BENCH_NUM_CYCLES);
+
+            mem_free();
+        }
+    }
+
+    free(allocs);
+    printf("\n");
+}
+
+/*
+ * BENCH_NUM_BUFFERS buffers of 64-4096 bytes, half of them freed again,
+ * in a pool opened for the peak and in a growable one opened at 64 KiB.
+ */
+static void bench_growable(void) {
+    const alloc_policy policies[] = { FIRST_FIT, TLSF };
+    const size_t peak_size = (size_t) BENCH_NUM_BUFFERS * 4096;
+
+    printf("growable: %u buffers of 64-4096 bytes\n", BENCH_NUM_BUFFERS);
+    printf("%-15s %10s %10s %12s\n", "policy", "pool", "alloc ns", "total KiB");
+
+    alloc_pt *allocs = malloc(BENCH_NUM_BUFFERS * sizeof(alloc_pt));
+
+    for (unsigned p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        for (int grow = 0; grow < 2; ++grow) {
+            srand(1);
+            mem_init();
+            pool_pt pool = grow ?
+                           mem_pool_open_ex(64 * 1024, policies[p], POOL_GROWABLE) :
+                           mem_pool_open(peak_size, policies[p]);
+
+            long long start = now_ns();
+            for (unsigned u = 0; u < BENCH_NUM_BUFFERS; ++u) {
+                allocs[u] = mem_new_alloc(pool, 64 + (size_t) rand() % 4033);
+                if (u % 2 == 1) {
+                    mem_del_alloc(pool, allocs[u - 1]);
+                }
+            }
+            long long alloc_ns = now_ns() - start;
+
+            printf("%-15s %10s %10.1f %12zu\n",
+                   policy_name(policies[p]), grow ? "growable" : "fixed",
+                   (double) alloc_ns / BENCH_NUM_BUFFERS, pool->total_size / 1024);
+
+            mem_free();
+        }
+    }
+
+    free(allocs);
+    printf("\n");
+}
+
+/*
+ * Doubling a pool that is full of BENCH_NUM_BUFFERS buffers of 4096 bytes:
+ * with mem_pool_resize, or by opening a pool twice the size and copying
+ * every allocation into it by hand.
+ */
+static void bench_resize(void) {
+    const size_t size = (size_t) BENCH_NUM_BUFFERS * 4096;
+
+    printf("resize: a pool of %zu KiB full of 4096-byte buffers, doubled\n", size / 1024);
+    printf("%-15s %10s %12s\n", "policy", "api", "resize us");
+
+    alloc_pt *allocs = malloc(BENCH_NUM_BUFFERS * sizeof(alloc_pt));
+
+    for (int api = 0; api < 2; ++api) {
+        mem_init();
+        pool_pt pool = mem_pool_open(size, FIRST_FIT);
+        for (unsigned u = 0; u < BENCH_NUM_BUFFERS; ++u) {
+            allocs[u] = mem_new_alloc(pool, 4096);
+            memset(allocs[u]->mem, (int) u, 4096);
+        }
+
+        long long start = now_ns();
+        if (api) {
+            mem_pool_resize(pool, 2 * size);
+        } else {
+            pool_pt bigger = mem_pool_open(2 * size, FIRST_FIT);
+            for (unsigned u = 0; u < BENCH_NUM_BUFFERS; ++u) {
+                alloc_pt copy = mem_new_alloc(bigger, allocs[u]->size);
+                memcpy(copy->mem, allocs[u]->mem, allocs[u]->size);
+                mem_del_alloc(pool, allocs[u]);
+                allocs[u] = copy;
+            }
+            mem_pool_close(pool);
+            pool = bigger;
+        }
+        long long resize_ns = now_ns() - start;
+
+        printf("%-15s %10s %12.1f\n",
+               policy_name(FIRST_FIT), api ? "resize" : "copy", (double) resize_ns / 1000);
+
+        for (unsigned u = 0; u < BENCH_NUM_BUFFERS; ++u) {
+            mem_del_alloc(pool, allocs[u]);
+        }
+        mem_pool_close(pool);
+        mem_free();
+    }
+
+    free(allocs);
+    printf("\n");
+}
+
+/*
+ * Dependent 8-byte reads at random offsets of one allocation that spans a
+ * 1 GiB pool, opened with and without POOL_HUGE_PAGES. With 4 KiB pages
+ * nearly every read misses the TLB.
+ */
+static void bench_huge_pages(void) {
+    const size_t num_words = BENCH_TLB_POOL_SIZE / sizeof(uint64_t);
+
+    printf("huge_pages: %u random reads over a %zu MiB pool\n",
+           BENCH_NUM_ACCESSES, BENCH_TLB_POOL_SIZE >> 20);
+    printf("%-15s %10s %12s %12s\n", "policy", "pages", "touch ms", "ns/read");
+
+    for (int huge = 0; huge < 2; ++huge) {
+        mem_init();
+        pool_pt pool = mem_pool_open_ex(BENCH_TLB_POOL_SIZE, FIRST_FIT, huge ? POOL_HUGE_PAGES : 0);
+        alloc_pt alloc = mem_new_alloc(pool, BENCH_TLB_POOL_SIZE);
+        uint64_t *words = (uint64_t *) alloc->mem;
+
+        long long start = now_ns();
+        memset(words, 0, BENCH_TLB_POOL_SIZE);
+        long long touch_ns = now_ns() - start;
+
+        // each index depends on the word read before it, so reads do not overlap
+        uint64_t x = 88172645463325252ULL, sum = 0;
+        start = now_ns();
+        for (unsigned u = 0; u < BENCH_NUM_ACCESSES; ++u) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            uint64_t word = words[(x + sum) % num_words];
+            sum += word;
+        }
+        long long read_ns = now_ns() - start;
+        volatile uint64_t sink = sum; // keeps the reads
+        (void) sink;
+
+        printf("%-15s %10s %12.1f %12.1f\n", policy_name(FIRST_FIT), huge ? "huge" : "base",
+               (double) touch_ns / 1e6, (double) read_ns / BENCH_NUM_ACCESSES);
+
+        mem_del_alloc(pool, alloc);
+        mem_pool_close(pool);
+        mem_free();
+    }
+    printf("\n");
+}
+
+/*
+ * The first requests served from a 256 MiB pool, each a 1 MiB allocation
+ * that is written in full, with and without POOL_PREFAULT: the time to
+ * open the pool, the part of it spent populating, and the latency of the
+ * requests.
+ */
+static void bench_prefault(void) {
+    const unsigned num_requests = (unsigned) (BENCH_PREFAULT_POOL_SIZE / BENCH_REQUEST_SIZE);
+
+    printf("prefault: %u requests of %zu KiB from a fresh %zu MiB pool\n",
+           num_requests, BENCH_REQUEST_SIZE >> 10, BENCH_PREFAULT_POOL_SIZE >> 20);
+    printf("%-15s %10s %10s %12s %10s %10s\n",
+           "policy", "prefault", "open ms", "populate ms", "p50 us", "max us");
+
+    long long *lat = malloc(num_requests * sizeof(long long));
+    alloc_pt *allocs = malloc(num_requests * sizeof(alloc_pt));
+
+    for (int prefault = 0; prefault < 2; ++prefault) {
+        mem_init();
+        long long start = now_ns();
+        pool_pt pool = mem_pool_open_ex(BENCH_PREFAULT_POOL_SIZE, FIRST_FIT, prefault ? POOL_PREFAULT : 0);
+        long long open_ns = now_ns() - start;
+
+        for (unsigned u = 0; u < num_requests; ++u) {
+            start = now_ns();
+            allocs[u] = mem_new_alloc(pool, BENCH_REQUEST_SIZE);
+            memset(allocs[u]->mem, (int) u, BENCH_REQUEST_SIZE);
+            lat[u] = now_ns() - start;
+        }
+        qsort(lat, num_requests, sizeof(long long), cmp_ll);
+
+        printf("%-15s %10s %10.1f %12.1f %10.1f %10.1f\n",
+               policy_name(FIRST_FIT), prefault ? "yes" : "no", (double) open_ns / 1e6,
+               (double) pool->prefault_ns / 1e6, (double) lat[num_requests / 2] / 1000,
+               (double) lat[num_requests - 1] / 1000);
+
+        for (unsigned u = 0; u < num_requests; ++u) {
+            mem_del_alloc(pool, allocs[u]);
+        }
+        mem_pool_close(pool);
+        mem_free();
+    }
+
+    free(allocs);
+    free(lat);
+    printf("\n");
+}
+
+
+/*****         driver routine          *****/
+
+int main(int argc, char *argv[]) {
+    const char *only = (argc > 1) ? argv[1] : NULL;
+
+    if (!only || strcmp(only, "gap_latency") == 0) bench_gap_latency();
+    if (!only || strcmp(only, "node_growth") == 0) bench_node_growth();
+    if (!only || strcmp(only, "free_heavy") == 0) bench_free_heavy();
+    if (!only || strcmp(only, "next_fit") == 0) bench_next_fit();
+    if (!only || strcmp(only, "fragmentation") == 0) bench_fragmentation();
+    if (!only || strcmp(only, "small_objects") == 0) bench_small_objects();
+    if (!only || strcmp(only, "arena") == 0) bench_arena();
+    if (!only || strcmp(only, "rollback") == 0) bench_rollback();
+    if (!only || strcmp(only, "aligned") == 0) bench_aligned();
+    if (!only || strcmp(only, "realloc") == 0) bench_realloc();
+    if (!only || strcmp(only, "batch") == 0) bench_batch();
+    if (!only || strcmp(only, "teardown") == 0) bench_teardown();
+    if (!only || strcmp(only, "recycle") == 0) bench_recycle();
+    if (!only || strcmp(only, "growable") == 0) bench_growable();
+    if (!only || strcmp(only, "resize") == 0) bench_resize();
+    if (!only || strcmp(only, "huge_pages") == 0) bench_huge_pages();
+    if (!only || strcmp(only, "prefault") == 0) bench_prefault();
+
+    return 0;
+}
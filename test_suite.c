@@ -4,9 +4,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <setjmp.h>
 
 #include "cmocka.h"
@@ -25,6 +27,7 @@
 
 static const unsigned NUM_TEST_ITERATIONS = NUM_ITERATIONS;
 static const unsigned POOL_SIZE           = 1000000;
+static const unsigned GROW_POOL_SIZE      = 1000;
 
 
 /*****         helper routines         *****/
@@ -235,6 +238,45 @@ static void test_pool_nonempty(void **state) {
 }
 
 
+static void test_pool_bad_free(void **state) {
+    (void) state; /* unused */
+
+    pool_pt pool0 = NULL, pool1 = NULL;
+
+    alloc_status status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating two pools of %lu bytes with policy %s\n",
+         (long) POOL_SIZE, "FIRST_FIT");
+    pool0 = mem_pool_open(POOL_SIZE, FIRST_FIT);
+    assert_non_null(pool0);
+    pool1 = mem_pool_open(POOL_SIZE, FIRST_FIT);
+    assert_non_null(pool1);
+
+    alloc_pt alloc = mem_new_alloc(pool0, 100);
+    assert_non_null(alloc);
+
+    INFO("Freeing through the wrong pool\n");
+    assert_int_equal(mem_del_alloc(pool1, alloc), ALLOC_NOT_FREED);
+
+    INFO("Freeing a pointer into the middle of a handle\n");
+    assert_int_equal(mem_del_alloc(pool0, (alloc_pt) ((char *) alloc + 1)), ALLOC_NOT_FREED);
+
+    INFO("Freeing twice\n");
+    assert_int_equal(mem_del_alloc(pool0, alloc), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool0, alloc), ALLOC_NOT_FREED);
+
+    assert_int_equal(pool0->num_allocs, 0);
+    assert_int_equal(pool0->num_gaps, 1);
+
+    INFO("Closing pools\n");
+    assert_int_equal(mem_pool_close(pool0), ALLOC_OK);
+    assert_int_equal(mem_pool_close(pool1), ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+}
+
 /*******************************************/
 /***       2. USER-FACING METADATA       ***/
 /*******************************************/
@@ -1531,6 +1573,428 @@ static void test_pool_scenario10(void **state) {
     check_pool(pool, exp0);
 }
 
+static void test_pool_scenario27(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 27:
+     *
+     * 1. Pool starts out as a single gap.
+     * 2. Allocate 6 x 100.
+     * 3. Deallocate 4, then 1. Gaps of 100 at +400 and +100.
+     * 4. Allocate 200. Neither 100 gap fits, it goes to the tail.
+     * 5. Deallocate 2. The gap at +100 grows to 200.
+     * 6. Allocate 150. The lowest sufficient gap is at +100.
+     * 7. Allocate 100. The gap left at +250 is too small, +400 fits.
+     * 8. Clean up.
+     */
+
+    const unsigned NUM_ALLOCS = 6;
+
+    alloc_pt *allocs = (alloc_pt *) calloc(NUM_ALLOCS, sizeof(alloc_pt));
+    assert_non_null(allocs);
+
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        allocs[i] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[i]);
+    }
+    assert_int_equal(mem_del_alloc(pool, allocs[4]), ALLOC_OK); allocs[4]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[1]), ALLOC_OK); allocs[1]=0;
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 200);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 600);
+
+    assert_int_equal(mem_del_alloc(pool, allocs[2]), ALLOC_OK); allocs[2]=0;
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 500, 4, 3);
+
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 150);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 100);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc2);
+    assert_ptr_equal(alloc2->mem, pool->mem + 400);
+
+    pool_segment_t exp1[8] =
+            {
+                    {100, 1},
+                    {150, 1},
+                    {50, 0},
+                    {100, 1},
+                    {100, 1},
+                    {100, 1},
+                    {200, 1},
+                    {pool->total_size - 800, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 750, 6, 2);
+    check_pool(pool, exp1);
+
+
+    // clean up
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        if (allocs[i])
+            assert_int_equal(mem_del_alloc(pool, allocs[i]), ALLOC_OK);
+    }
+    free(allocs);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 1);
+}
+
+static void test_pool_scenario34(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 34:
+     *
+     * 1. Allocate 10.
+     * 2. Allocate 100 aligned to 64. The padding up to the next multiple
+     *    of 64 stays a gap before it.
+     * 3. Allocate 4096 aligned to 4096, with its own padding gap.
+     * 4. Allocate the size of the first padding. First fit takes it whole.
+     * 5. Allocate with alignments 0 and 24, which fail.
+     * 6. Deallocate 4096. It merges with its padding and the tail.
+     * 7. Clean up.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 10);
+    assert_non_null(alloc0);
+
+    alloc_pt alloc1 = mem_new_alloc_aligned(pool, 100, 64);
+    assert_non_null(alloc1);
+    assert_int_equal((uintptr_t) alloc1->mem % 64, 0);
+    size_t pad0 = alloc1->mem - (pool->mem + 10);
+    assert_true(pad0 > 0 && pad0 < 64);
+
+    alloc_pt alloc2 = mem_new_alloc_aligned(pool, 4096, 4096);
+    assert_non_null(alloc2);
+    assert_int_equal((uintptr_t) alloc2->mem % 4096, 0);
+    size_t pad1 = alloc2->mem - (alloc1->mem + 100);
+    assert_true(pad1 > 0 && pad1 < 4096);
+
+    size_t tail = pool->total_size - (alloc2->mem + 4096 - pool->mem);
+    pool_segment_t exp1[6] =
+            {
+                    {10, 1},
+                    {pad0, 0},
+                    {100, 1},
+                    {pad1, 0},
+                    {4096, 1},
+                    {tail, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 4206, 3, 3);
+    check_pool(pool, exp1);
+
+    alloc_pt alloc3 = mem_new_alloc(pool, pad0);
+    assert_non_null(alloc3);
+    assert_ptr_equal(alloc3->mem, pool->mem + 10);
+
+    assert_null(mem_new_alloc_aligned(pool, 100, 0));
+    assert_null(mem_new_alloc_aligned(pool, 100, 24));
+
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+
+    pool_segment_t exp2[4] =
+            {
+                    {10, 1},
+                    {pad0, 1},
+                    {100, 1},
+                    {pad1 + 4096 + tail, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 110 + pad0, 3, 1);
+    check_pool(pool, exp2);
+
+
+    // clean up
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 1);
+}
+
+static void test_pool_scenario35(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 35:
+     *
+     * 1. Allocate 3 x 100. Deallocate 1, which leaves a gap of 100 at +100.
+     * 2. Reallocate 0 to 150. It grows in place into the gap.
+     * 3. Reallocate 0 to 80. It shrinks in place, and the cut-off end
+     *    merges with what is left of the gap.
+     * 4. Reallocate 2 to 1000. It grows in place into the tail.
+     * 5. Reallocate 0 to 500. The gap after it is too small, so it moves
+     *    to the tail with its contents, and its old place becomes a gap.
+     * 6. Reallocate an allocation that was already moved, which fails.
+     * 7. Clean up.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    alloc_pt alloc1 = mem_new_alloc(pool, 100);
+    alloc_pt alloc2 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_non_null(alloc1);
+    assert_non_null(alloc2);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    memset(alloc0->mem, 'x', 100);
+
+    assert_ptr_equal(mem_realloc_alloc(pool, alloc0, 150), alloc0);
+    assert_int_equal(alloc0->size, 150);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 250, 2, 2);
+
+    assert_ptr_equal(mem_realloc_alloc(pool, alloc0, 80), alloc0);
+
+    pool_segment_t exp1[4] =
+            {
+                    {80, 1},
+                    {120, 0},
+                    {100, 1},
+                    {pool->total_size - 300, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 180, 2, 2);
+    check_pool(pool, exp1);
+
+    assert_ptr_equal(mem_realloc_alloc(pool, alloc2, 1000), alloc2);
+    assert_ptr_equal(alloc2->mem, pool->mem + 200);
+
+    alloc_pt moved = mem_realloc_alloc(pool, alloc0, 500);
+    assert_non_null(moved);
+    assert_ptr_not_equal(moved, alloc0);
+    assert_ptr_equal(moved->mem, pool->mem + 1200);
+    for (int i=0; i<80; ++i) {
+        assert_int_equal(moved->mem[i], 'x');
+    }
+
+    pool_segment_t exp2[4] =
+            {
+                    {200, 0},
+                    {1000, 1},
+                    {500, 1},
+                    {pool->total_size - 1700, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 1500, 2, 2);
+    check_pool(pool, exp2);
+
+    assert_null(mem_realloc_alloc(pool, alloc0, 10));
+
+
+    // clean up
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, moved), ALLOC_OK);
+
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 1);
+}
+
+static void test_pool_scenario36(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 36:
+     *
+     * 1. Allocate 4 x 100. Deallocate 1, which leaves a gap of 100 at +100.
+     * 2. Allocate a batch of 60 and 40. Together they fit the gap exactly.
+     * 3. Allocate a batch of 30, 200, and 50. They go to the tail, one
+     *    right after the other.
+     * 4. Allocate a batch of 100 and more than the pool, which fails
+     *    without allocating anything.
+     * 5. Clean up.
+     */
+
+    alloc_pt allocs[4];
+    for (int i=0; i<4; ++i) {
+        allocs[i] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[i]);
+    }
+    assert_int_equal(mem_del_alloc(pool, allocs[1]), ALLOC_OK);
+
+    size_t sizes1[2] = {60, 40};
+    alloc_pt batch1[2];
+    assert_int_equal(mem_new_alloc_batch(pool, sizes1, 2, batch1), ALLOC_OK);
+    assert_ptr_equal(batch1[0]->mem, pool->mem + 100);
+    assert_ptr_equal(batch1[1]->mem, pool->mem + 160);
+
+    size_t sizes2[3] = {30, 200, 50};
+    alloc_pt batch2[3];
+    assert_int_equal(mem_new_alloc_batch(pool, sizes2, 3, batch2), ALLOC_OK);
+
+    pool_segment_t exp[9] =
+            {
+                    {100, 1},
+                    {60, 1},
+                    {40, 1},
+                    {100, 1},
+                    {100, 1},
+                    {30, 1},
+                    {200, 1},
+                    {50, 1},
+                    {pool->total_size - 680, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 680, 8, 1);
+    check_pool(pool, exp);
+
+    size_t sizes3[2] = {100, POOL_SIZE};
+    alloc_pt batch3[2];
+    assert_int_equal(mem_new_alloc_batch(pool, sizes3, 2, batch3), ALLOC_FAIL);
+    assert_null(batch3[0]);
+    assert_null(batch3[1]);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 680, 8, 1);
+    check_pool(pool, exp);
+
+
+    // clean up
+    assert_int_equal(mem_del_alloc(pool, allocs[0]), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, allocs[2]), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, allocs[3]), ALLOC_OK);
+    for (int i=0; i<2; ++i) {
+        assert_int_equal(mem_del_alloc(pool, batch1[i]), ALLOC_OK);
+    }
+    for (int i=0; i<3; ++i) {
+        assert_int_equal(mem_del_alloc(pool, batch2[i]), ALLOC_OK);
+    }
+
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 1);
+}
+
+static void test_pool_scenario37(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 37:
+     *
+     * 1. Allocate 6 x 100. Deallocate 2.
+     * 2. Deallocate a batch of 3, 1, and 5. 1 to 3 merge into one gap
+     *    with the gap of 2, and 5 merges with the tail.
+     * 3. Deallocate a batch of 0 twice. 0 is deallocated and merges with
+     *    the gap after it, and the second one is not freed.
+     * 4. Clean up.
+     */
+
+    alloc_pt allocs[6];
+    for (int i=0; i<6; ++i) {
+        allocs[i] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[i]);
+    }
+    assert_int_equal(mem_del_alloc(pool, allocs[2]), ALLOC_OK);
+
+    alloc_pt batch1[3] = {allocs[3], allocs[1], allocs[5]};
+    assert_int_equal(mem_del_alloc_batch(pool, batch1, 3), ALLOC_OK);
+
+    pool_segment_t exp1[4] =
+            {
+                    {100, 1},
+                    {300, 0},
+                    {100, 1},
+                    {pool->total_size - 500, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 200, 2, 2);
+    check_pool(pool, exp1);
+
+    alloc_pt batch2[2] = {allocs[0], allocs[0]};
+    assert_int_equal(mem_del_alloc_batch(pool, batch2, 2), ALLOC_NOT_FREED);
+
+    pool_segment_t exp2[3] =
+            {
+                    {400, 0},
+                    {100, 1},
+                    {pool->total_size - 500, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 100, 1, 2);
+    check_pool(pool, exp2);
+
+
+    // clean up
+    assert_int_equal(mem_del_alloc(pool, allocs[4]), ALLOC_OK);
+
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 1);
+}
+
+#ifdef __linux__
+static void test_pool_scenario40(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 40:
+     *
+     * 1. Allocate 100 and 200.
+     * 2. Resize the pool to twice its size. The gap at the end grows.
+     * 3. Allocate more than the old size, which only fits now.
+     * 4. Resize the pool to 1000, which fails, since an allocation is at
+     *    the end.
+     * 5. Deallocate the big allocation and resize the pool to 1000. The
+     *    gap at the end is cut.
+     * 6. Resize the pool to 300. The gap at the end is gone.
+     * 7. Resize the pool to 200, which fails.
+     * 8. Resize the pool back to its size. The end is a new gap, and the
+     *    allocations have not moved.
+     * 9. Resize the pool to 64 times its size, which only works if the
+     *    address space after its reserve is free. Either way, resizing it
+     *    to 16 times its size, within the reserve, works, and so does
+     *    resizing it back.
+     * 10. Clean up.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    alloc_pt alloc1 = mem_new_alloc(pool, 200);
+    assert_non_null(alloc0);
+    assert_non_null(alloc1);
+    char *mem = pool->mem;
+
+    assert_int_equal(mem_pool_resize(pool, 2 * POOL_SIZE), ALLOC_OK);
+    check_metadata(pool, FIRST_FIT, 2 * POOL_SIZE, 300, 2, 1);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, POOL_SIZE + 500);
+    assert_non_null(alloc2);
+    alloc2->mem[POOL_SIZE + 499] = 'x';
+
+    assert_int_equal(mem_pool_resize(pool, 1000), ALLOC_FAIL);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_pool_resize(pool, 1000), ALLOC_OK);
+
+    pool_segment_t exp1[3] =
+            {
+                    {100, 1},
+                    {200, 1},
+                    {700, 0},
+            };
+    check_metadata(pool, FIRST_FIT, 1000, 300, 2, 1);
+    check_pool(pool, exp1);
+
+    assert_int_equal(mem_pool_resize(pool, 300), ALLOC_OK);
+    check_metadata(pool, FIRST_FIT, 300, 300, 2, 0);
+    assert_int_equal(mem_pool_resize(pool, 200), ALLOC_FAIL);
+
+    assert_int_equal(mem_pool_resize(pool, POOL_SIZE), ALLOC_OK);
+    assert_ptr_equal(pool->mem, mem);
+    assert_ptr_equal(alloc1->mem, mem + 100);
+
+    pool_segment_t exp2[3] =
+            {
+                    {100, 1},
+                    {200, 1},
+                    {POOL_SIZE - 300, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 300, 2, 1);
+    check_pool(pool, exp2);
+
+    mem_pool_resize(pool, 64 * (size_t) POOL_SIZE);
+    assert_int_equal(mem_pool_resize(pool, 16 * (size_t) POOL_SIZE), ALLOC_OK);
+    assert_int_equal(mem_pool_resize(pool, POOL_SIZE), ALLOC_OK);
+    check_pool(pool, exp2);
+
+
+    // clean up
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 1);
+}
+#endif
+
 /*******************************************/
 /***        4. BEST_FIT SCENARIOS        ***/
 /*******************************************/
@@ -2315,37 +2779,1705 @@ static void test_pool_scenario19(void **state) {
     check_pool(pool, exp0);
 }
 
-/*******************************************/
-/***          5. STRESS TEST             ***/
-/***                                     ***/
-/***         [non-functional]            ***/
-/***         [see NOTE below]            ***/
-/*******************************************/
-
-void test_pool_stresstest(void **state) {
-    (void) state; /* unused */
-
-    const unsigned num_pools = 200;
-    const unsigned num_allocations = 1000;
-    const unsigned min_alloc_size = 10;
-    const unsigned pool_size =
-            (num_allocations / 2) *
-            (2 * min_alloc_size + (num_allocations - 1) * min_alloc_size);
-    assert_int_equal(pool_size, 5005000);
-
-
-    pool_pt pools[num_pools];
-    alloc_pt allocations[num_pools][num_allocations];
+static void test_pool_scenario20(void **state) {
+    pool_pt pool = *state;
 
     /*
-     * NOTE: This will work iff the address of the allocation
-     * in the pool is returned to the user instead of the
-     * address of the allocation record. Since allocation records
-     * are a part of the nodes, when the node heap is reallocated
-     * the node addresses shift with it, and so do the allocation
-     * record addresses. The allocation addresses on the pool
-     * remain the same, however, so they can be returned to the
-     * user and gotten from the user upon request for deletion.
+     * Scenario 20:
+     *
+     * 1. Pool starts out as a single gap.
+     * 2. Allocate 12 x 100.
+     * 3. Deallocate (1, 2, 3), (5, 6), (8, 9).
+     * 4. Allocate 200. Two equal gaps fit exactly, the lower one wins.
+     * 5. Allocate 250. Only the 300 gap is big enough below the tail.
+     * 6. Allocate 50. The 50 remainder is the best fit.
+     * 7. Allocate 150. The remaining 200 gap is the best fit.
+     * 8. Clean up.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0},
+            };
+    check_pool(pool, exp0);
+
+
+    const unsigned NUM_ALLOCS = 12;
+
+    alloc_pt *allocs = (alloc_pt *) calloc(NUM_ALLOCS, sizeof(alloc_pt));
+    assert_non_null(allocs);
+
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        allocs[i] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[i]);
+    }
+    assert_int_equal(mem_del_alloc(pool, allocs[1]), ALLOC_OK); allocs[1]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[2]), ALLOC_OK); allocs[2]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[3]), ALLOC_OK); allocs[3]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[5]), ALLOC_OK); allocs[5]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[6]), ALLOC_OK); allocs[6]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[8]), ALLOC_OK); allocs[8]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[9]), ALLOC_OK); allocs[9]=0;
+
+    pool_segment_t exp1[9] =
+            {
+                    {100, 1},
+                    {300, 0},
+                    {100, 1},
+                    {200, 0},
+                    {100, 1},
+                    {200, 0},
+                    {100, 1},
+                    {100, 1},
+                    {pool->total_size - 1200, 0},
+            };
+    check_metadata(pool, BEST_FIT, POOL_SIZE, 500, 5, 4);
+    check_pool(pool, exp1);
+
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 200);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 500);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 250);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 100);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc2);
+    assert_ptr_equal(alloc2->mem, pool->mem + 350);
+
+    alloc_pt alloc3 = mem_new_alloc(pool, 150);
+    assert_non_null(alloc3);
+    assert_ptr_equal(alloc3->mem, pool->mem + 800);
+
+    pool_segment_t exp2[11] =
+            {
+                    {100, 1},
+                    {250, 1},
+                    {50, 1},
+                    {100, 1},
+                    {200, 1},
+                    {100, 1},
+                    {150, 1},
+                    {50, 0},
+                    {100, 1},
+                    {100, 1},
+                    {pool->total_size - 1200, 0},
+            };
+    check_metadata(pool, BEST_FIT, POOL_SIZE, 1150, 9, 2);
+    check_pool(pool, exp2);
+
+
+    // clean up
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        if (allocs[i])
+            assert_int_equal(mem_del_alloc(pool, allocs[i]), ALLOC_OK);
+    }
+    free(allocs);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+
+
+    check_metadata(pool, BEST_FIT, POOL_SIZE, 0, 0, 1);
+    check_pool(pool, exp0);
+}
+
+static void test_pool_scenario38(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 38:
+     *
+     * 1. Allocate 2000 x 100, enough to grow the node heap, and deallocate
+     *    every other one.
+     * 2. Reset the pool. It is a single gap again.
+     * 3. Deallocate one of the old allocations, which is not freed.
+     * 4. Allocate 50. It is at the start of the pool.
+     * 5. Clean up.
+     */
+
+    alloc_pt allocs[2000];
+    for (int i=0; i<2000; ++i) {
+        allocs[i] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[i]);
+    }
+    for (int i=0; i<2000; i+=2) {
+        assert_int_equal(mem_del_alloc(pool, allocs[i]), ALLOC_OK);
+    }
+    check_metadata(pool, BEST_FIT, POOL_SIZE, 100000, 1000, 1001);
+
+    assert_int_equal(mem_pool_reset(pool), ALLOC_OK);
+
+    pool_segment_t exp1[1] =
+            {
+                    {POOL_SIZE, 0},
+            };
+    check_metadata(pool, BEST_FIT, POOL_SIZE, 0, 0, 1);
+    check_pool(pool, exp1);
+
+    assert_int_equal(mem_del_alloc(pool, allocs[1]), ALLOC_NOT_FREED);
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem);
+
+    pool_segment_t exp2[2] =
+            {
+                    {50, 1},
+                    {POOL_SIZE - 50, 0},
+            };
+    check_metadata(pool, BEST_FIT, POOL_SIZE, 50, 1, 1);
+    check_pool(pool, exp2);
+
+
+    // clean up
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+    check_metadata(pool, BEST_FIT, POOL_SIZE, 0, 0, 1);
+}
+
+/*******************************************/
+/***     5. SEGREGATED_FIT SCENARIOS     ***/
+/*******************************************/
+
+static int pool_sf_setup(void **state) {
+    alloc_status status;
+    pool_pt pool = NULL;
+
+    status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating pool of %lu bytes with policy %s\n",
+         (long) POOL_SIZE, "SEGREGATED_FIT");
+    pool = mem_pool_open(POOL_SIZE, SEGREGATED_FIT);
+    assert_non_null(pool);
+
+    *state = pool;
+
+    return 0;
+}
+
+static int pool_sf_teardown(void **state) {
+    pool_pt pool = *state;
+    alloc_status status;
+
+    INFO("Closing pool\n");
+    status = mem_pool_close(pool);
+    assert_int_equal(status, ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+
+    return 0;
+}
+
+static void test_pool_scenario21(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 21:
+     *
+     * 1. Pool starts out as a single gap.
+     * 2. Allocate 10 x 100.
+     * 3. Deallocate (2, 1, 3), (6, 5), 8
+     *    Gaps: 300 in class [256, 512), 200 in [128, 256), 100 in [64, 128).
+     * 4. Allocate 100. The 100 gap is in the request's own class.
+     * 5. Allocate 150. The 200 gap is in the request's own class.
+     * 6. Allocate 250. Its own class is now empty, the 300 gap is next.
+     * 7. Clean up.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0},
+            };
+    check_pool(pool, exp0);
+
+
+    const unsigned NUM_ALLOCS = 10;
+
+    alloc_pt *allocs = (alloc_pt *) calloc(NUM_ALLOCS, sizeof(alloc_pt));
+    assert_non_null(allocs);
+
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        allocs[i] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[i]);
+    }
+    assert_int_equal(mem_del_alloc(pool, allocs[2]), ALLOC_OK); allocs[2]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[1]), ALLOC_OK); allocs[1]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[3]), ALLOC_OK); allocs[3]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[6]), ALLOC_OK); allocs[6]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[5]), ALLOC_OK); allocs[5]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[8]), ALLOC_OK); allocs[8]=0;
+
+    pool_segment_t exp1[8] =
+            {
+                    {100, 1},
+                    {300, 0},
+                    {100, 1},
+                    {200, 0},
+                    {100, 1},
+                    {100, 0},
+                    {100, 1},
+                    {pool->total_size - 1000, 0},
+            };
+    check_metadata(pool, SEGREGATED_FIT, POOL_SIZE, 400, 4, 4);
+    check_pool(pool, exp1);
+
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 800);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 150);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 500);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 250);
+    assert_non_null(alloc2);
+    assert_ptr_equal(alloc2->mem, pool->mem + 100);
+
+    pool_segment_t exp2[10] =
+            {
+                    {100, 1},
+                    {250, 1},
+                    {50, 0},
+                    {100, 1},
+                    {150, 1},
+                    {50, 0},
+                    {100, 1},
+                    {100, 1},
+                    {100, 1},
+                    {pool->total_size - 1000, 0},
+            };
+    check_metadata(pool, SEGREGATED_FIT, POOL_SIZE, 900, 7, 3);
+    check_pool(pool, exp2);
+
+
+    // clean up
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        if (allocs[i])
+            assert_int_equal(mem_del_alloc(pool, allocs[i]), ALLOC_OK);
+    }
+    free(allocs);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+
+
+    check_metadata(pool, SEGREGATED_FIT, POOL_SIZE, 0, 0, 1);
+    check_pool(pool, exp0);
+}
+
+static void test_pool_scenario22(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 22:
+     *
+     * 1. Pool starts out as a single gap.
+     * 2. Allocate 100, 10000, 100.
+     * 3. Deallocate the 10000, leaving a gap in class [8192, 16384).
+     * 4. Try to allocate 989900. No class holds a big enough gap.
+     * 5. Allocate 9000. It comes out of the 10000 gap.
+     * 6. Clean up.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, 10000);
+    assert_non_null(alloc1);
+    alloc_pt alloc2 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc2);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+
+    assert_null(mem_new_alloc(pool, 989900));
+
+    pool_segment_t exp1[4] =
+            {
+                    {100, 1},
+                    {10000, 0},
+                    {100, 1},
+                    {pool->total_size - 10200, 0},
+            };
+    check_metadata(pool, SEGREGATED_FIT, POOL_SIZE, 200, 2, 2);
+    check_pool(pool, exp1);
+
+
+    alloc1 = mem_new_alloc(pool, 9000);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 100);
+
+    pool_segment_t exp2[5] =
+            {
+                    {100, 1},
+                    {9000, 1},
+                    {1000, 0},
+                    {100, 1},
+                    {pool->total_size - 10200, 0},
+            };
+    check_pool(pool, exp2);
+
+
+    // clean up
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+
+    check_metadata(pool, SEGREGATED_FIT, POOL_SIZE, 0, 0, 1);
+}
+
+/*******************************************/
+/***          6. TLSF SCENARIOS          ***/
+/*******************************************/
+
+static int pool_tlsf_setup(void **state) {
+    alloc_status status;
+    pool_pt pool = NULL;
+
+    status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating pool of %lu bytes with policy %s\n",
+         (long) POOL_SIZE, "TLSF");
+    pool = mem_pool_open(POOL_SIZE, TLSF);
+    assert_non_null(pool);
+
+    *state = pool;
+
+    return 0;
+}
+
+static int pool_tlsf_teardown(void **state) {
+    pool_pt pool = *state;
+    alloc_status status;
+
+    INFO("Closing pool\n");
+    status = mem_pool_close(pool);
+    assert_int_equal(status, ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+
+    return 0;
+}
+
+static void test_pool_scenario23(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 23:
+     *
+     * 1. Pool starts out as a single gap.
+     * 2. Allocate 10 x 100.
+     * 3. Deallocate (2, 1, 3), (6, 5), 8
+     * 4. Allocate 100. Its bin [100, 104) holds the 100 gap.
+     * 5. Allocate 150. Rounded up to bin [152, 160), the 200 gap is next.
+     * 6. Allocate 250. Rounded up to bin [256, 272), the 300 gap is next.
+     * 7. Clean up.
+     */
+
+    const unsigned NUM_ALLOCS = 10;
+
+    alloc_pt *allocs = (alloc_pt *) calloc(NUM_ALLOCS, sizeof(alloc_pt));
+    assert_non_null(allocs);
+
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        allocs[i] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[i]);
+    }
+    assert_int_equal(mem_del_alloc(pool, allocs[2]), ALLOC_OK); allocs[2]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[1]), ALLOC_OK); allocs[1]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[3]), ALLOC_OK); allocs[3]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[6]), ALLOC_OK); allocs[6]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[5]), ALLOC_OK); allocs[5]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[8]), ALLOC_OK); allocs[8]=0;
+
+    check_metadata(pool, TLSF, POOL_SIZE, 400, 4, 4);
+
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 800);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 150);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 500);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 250);
+    assert_non_null(alloc2);
+    assert_ptr_equal(alloc2->mem, pool->mem + 100);
+
+    pool_segment_t exp1[10] =
+            {
+                    {100, 1},
+                    {250, 1},
+                    {50, 0},
+                    {100, 1},
+                    {150, 1},
+                    {50, 0},
+                    {100, 1},
+                    {100, 1},
+                    {100, 1},
+                    {pool->total_size - 1000, 0},
+            };
+    check_metadata(pool, TLSF, POOL_SIZE, 900, 7, 3);
+    check_pool(pool, exp1);
+
+
+    // clean up
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        if (allocs[i])
+            assert_int_equal(mem_del_alloc(pool, allocs[i]), ALLOC_OK);
+    }
+    free(allocs);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+
+    check_metadata(pool, TLSF, POOL_SIZE, 0, 0, 1);
+}
+
+static void test_pool_scenario24(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 24:
+     *
+     * 1. Pool starts out as a single gap.
+     * 2. Allocate 100, 102, 100, and 999698 to fill the pool.
+     * 3. Deallocate the 102. It is the only gap.
+     * 4. Allocate 101. Rounding up skips the 102 gap's bin, but
+     *    the request's own bin is still tried before giving up.
+     * 5. Allocate 2. No gap is left.
+     * 6. Clean up.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, 102);
+    assert_non_null(alloc1);
+    alloc_pt alloc2 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc2);
+    alloc_pt alloc3 = mem_new_alloc(pool, pool->total_size - 302);
+    assert_non_null(alloc3);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    check_metadata(pool, TLSF, POOL_SIZE, pool->total_size - 102, 3, 1);
+
+
+    alloc1 = mem_new_alloc(pool, 101);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 100);
+
+    pool_segment_t exp1[5] =
+            {
+                    {100, 1},
+                    {101, 1},
+                    {1, 0},
+                    {100, 1},
+                    {pool->total_size - 302, 1},
+            };
+    check_pool(pool, exp1);
+
+    assert_null(mem_new_alloc(pool, 2));
+
+
+    // clean up
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+
+    check_metadata(pool, TLSF, POOL_SIZE, 0, 0, 1);
+}
+
+/*******************************************/
+/***          7. BUDDY SCENARIOS         ***/
+/*******************************************/
+
+static int pool_buddy_setup(void **state) {
+    alloc_status status;
+    pool_pt pool = NULL;
+
+    status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating pool of %lu bytes with policy %s\n",
+         (long) POOL_SIZE, "BUDDY");
+    pool = mem_pool_open(POOL_SIZE, BUDDY);
+    assert_non_null(pool);
+
+    *state = pool;
+
+    return 0;
+}
+
+static int pool_buddy_teardown(void **state) {
+    pool_pt pool = *state;
+    alloc_status status;
+
+    INFO("Closing pool\n");
+    status = mem_pool_close(pool);
+    assert_int_equal(status, ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+
+    return 0;
+}
+
+static void test_pool_scenario25(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 25:
+     *
+     * 1. Pool starts out as one block per binary digit of 1000000.
+     * 2. Allocate 100. The 512 block splits into 128 + 128 + 256.
+     * 3. Allocate 20. The 64 block splits into 32 + 32.
+     * 4. Allocate 100. It takes the buddy of the first 100.
+     * 5. Deallocate the first 100. Its buddy is allocated, no merge.
+     * 6. Deallocate the second 100. It merges back up to 512.
+     * 7. Deallocate the 20. It merges back up to 64.
+     */
+
+    pool_segment_t exp0[7] =
+            {
+                    {524288, 0},
+                    {262144, 0},
+                    {131072, 0},
+                    {65536, 0},
+                    {16384, 0},
+                    {512, 0},
+                    {64, 0},
+            };
+    check_metadata(pool, BUDDY, POOL_SIZE, 0, 0, 7);
+    check_pool(pool, exp0);
+
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 999424);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 20);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 999936);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc2);
+    assert_ptr_equal(alloc2->mem, pool->mem + 999552);
+
+    pool_segment_t exp1[10] =
+            {
+                    {524288, 0},
+                    {262144, 0},
+                    {131072, 0},
+                    {65536, 0},
+                    {16384, 0},
+                    {128, 1},
+                    {128, 1},
+                    {256, 0},
+                    {32, 1},
+                    {32, 0},
+            };
+    check_metadata(pool, BUDDY, POOL_SIZE, 288, 3, 7);
+    check_pool(pool, exp1);
+
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    check_metadata(pool, BUDDY, POOL_SIZE, 160, 2, 8);
+
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+
+    check_metadata(pool, BUDDY, POOL_SIZE, 0, 0, 7);
+    check_pool(pool, exp0);
+}
+
+static void test_pool_scenario26(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 26:
+     *
+     * 1. Allocate 600000. It rounds up to 2^20, which no block holds.
+     * 2. Allocate 524288. It takes the largest block as it is.
+     * 3. Allocate 300000. It rounds up to 2^19, which is now taken.
+     * 4. Deallocate the 524288.
+     */
+
+    assert_null(mem_new_alloc(pool, 600000));
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 524288);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem);
+    check_metadata(pool, BUDDY, POOL_SIZE, 524288, 1, 6);
+
+    assert_null(mem_new_alloc(pool, 300000));
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+    check_metadata(pool, BUDDY, POOL_SIZE, 0, 0, 7);
+}
+
+static void test_pool_scenario43(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 43:
+     *
+     * 1. Allocate 524288, which takes the largest block.
+     * 2. Resize it to 300000 and then to 400000. Both are of the same
+     *    order as the block, so it stays in place and still reports the
+     *    whole block as its size, as when it was allocated.
+     * 3. Deallocate it. The whole block is free again.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 524288);
+    assert_non_null(alloc0);
+
+    assert_ptr_equal(mem_realloc_alloc(pool, alloc0, 300000), alloc0);
+    assert_int_equal(alloc0->size, 524288);
+    check_metadata(pool, BUDDY, POOL_SIZE, 524288, 1, 6);
+
+    assert_ptr_equal(mem_realloc_alloc(pool, alloc0, 400000), alloc0);
+    assert_int_equal(alloc0->size, 524288);
+    check_metadata(pool, BUDDY, POOL_SIZE, 524288, 1, 6);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc1);
+    assert_int_equal(alloc1->size, 128);
+    assert_ptr_equal(mem_realloc_alloc(pool, alloc1, 70), alloc1);
+    assert_int_equal(alloc1->size, 128);
+    assert_int_equal(pool->alloc_size, 524288 + 128);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+    check_metadata(pool, BUDDY, POOL_SIZE, 0, 0, 7);
+}
+
+/*******************************************/
+/***        8. NEXT_FIT SCENARIOS        ***/
+/*******************************************/
+
+static int pool_nf_setup(void **state) {
+    alloc_status status;
+    pool_pt pool = NULL;
+
+    status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating pool of %lu bytes with policy %s\n",
+         (long) POOL_SIZE, "NEXT_FIT");
+    pool = mem_pool_open(POOL_SIZE, NEXT_FIT);
+    assert_non_null(pool);
+
+    *state = pool;
+
+    return 0;
+}
+
+static int pool_nf_teardown(void **state) {
+    pool_pt pool = *state;
+    alloc_status status;
+
+    INFO("Closing pool\n");
+    status = mem_pool_close(pool);
+    assert_int_equal(status, ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+
+    return 0;
+}
+
+static void test_pool_scenario28(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 28:
+     *
+     * 1. Allocate 3 x 100.
+     * 2. Deallocate the first 100.
+     * 3. Allocate 100. It goes after the last allocation, not to +0.
+     * 4. Allocate the rest of the pool.
+     * 5. Allocate 50. The search wraps around to +0.
+     * 6. Deallocate the 100 at +200.
+     * 7. Deallocate the 50. It merges with the gap after it, which held
+     *    the rover, so the rover moves back to +0.
+     * 8. Allocate 80. It goes to +0, not to the gap at +200.
+     * 9. Clean up.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc1);
+    alloc_pt alloc2 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc2);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+    alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 300);
+
+    alloc_pt alloc3 = mem_new_alloc(pool, pool->total_size - 400);
+    assert_non_null(alloc3);
+    assert_ptr_equal(alloc3->mem, pool->mem + 400);
+
+    alloc_pt alloc4 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc4);
+    assert_ptr_equal(alloc4->mem, pool->mem);
+    check_metadata(pool, NEXT_FIT, POOL_SIZE, pool->total_size - 50, 5, 1);
+
+
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc4), ALLOC_OK);
+
+    alloc4 = mem_new_alloc(pool, 80);
+    assert_non_null(alloc4);
+    assert_ptr_equal(alloc4->mem, pool->mem);
+
+    pool_segment_t exp1[6] =
+            {
+                    {80, 1},
+                    {20, 0},
+                    {100, 1},
+                    {100, 0},
+                    {100, 1},
+                    {pool->total_size - 400, 1},
+            };
+    check_metadata(pool, NEXT_FIT, POOL_SIZE, pool->total_size - 120, 4, 2);
+    check_pool(pool, exp1);
+
+
+    // clean up
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc4), ALLOC_OK);
+
+    check_metadata(pool, NEXT_FIT, POOL_SIZE, 0, 0, 1);
+}
+
+/*******************************************/
+/***        9. WORST_FIT SCENARIOS       ***/
+/*******************************************/
+
+static int pool_wf_setup(void **state) {
+    alloc_status status;
+    pool_pt pool = NULL;
+
+    status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating pool of %lu bytes with policy %s\n",
+         (long) POOL_SIZE, "WORST_FIT");
+    pool = mem_pool_open(POOL_SIZE, WORST_FIT);
+    assert_non_null(pool);
+
+    *state = pool;
+
+    return 0;
+}
+
+static int pool_wf_teardown(void **state) {
+    pool_pt pool = *state;
+    alloc_status status;
+
+    INFO("Closing pool\n");
+    status = mem_pool_close(pool);
+    assert_int_equal(status, ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+
+    return 0;
+}
+
+static void test_pool_scenario29(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 29:
+     *
+     * 1. Allocate 10 x 100, and the rest of the pool.
+     * 2. Deallocate (2, 1, 3), (6, 5), 8. Gaps of 300, 200, 100.
+     * 3. Allocate 50. It is carved from the 300 gap.
+     * 4. Allocate 220. It is carved from what is left of it, 250.
+     * 5. Allocate 150. It is carved from the 200 gap.
+     * 6. Allocate 150. The largest gap is 100, so it fails.
+     * 7. Clean up.
+     */
+
+    const unsigned NUM_ALLOCS = 10;
+
+    alloc_pt *allocs = (alloc_pt *) calloc(NUM_ALLOCS, sizeof(alloc_pt));
+    assert_non_null(allocs);
+
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        allocs[i] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[i]);
+    }
+    alloc_pt rest = mem_new_alloc(pool, pool->total_size - 1000);
+    assert_non_null(rest);
+
+    assert_int_equal(mem_del_alloc(pool, allocs[2]), ALLOC_OK); allocs[2]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[1]), ALLOC_OK); allocs[1]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[3]), ALLOC_OK); allocs[3]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[6]), ALLOC_OK); allocs[6]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[5]), ALLOC_OK); allocs[5]=0;
+    assert_int_equal(mem_del_alloc(pool, allocs[8]), ALLOC_OK); allocs[8]=0;
+
+    check_metadata(pool, WORST_FIT, POOL_SIZE, pool->total_size - 600, 5, 3);
+
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 100);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 220);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 150);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 150);
+    assert_non_null(alloc2);
+    assert_ptr_equal(alloc2->mem, pool->mem + 500);
+
+    assert_null(mem_new_alloc(pool, 150));
+
+    pool_segment_t exp1[11] =
+            {
+                    {100, 1},
+                    {50, 1},
+                    {220, 1},
+                    {30, 0},
+                    {100, 1},
+                    {150, 1},
+                    {50, 0},
+                    {100, 1},
+                    {100, 0},
+                    {100, 1},
+                    {pool->total_size - 1000, 1},
+            };
+    check_metadata(pool, WORST_FIT, POOL_SIZE, pool->total_size - 180, 8, 3);
+    check_pool(pool, exp1);
+
+
+    // clean up
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        if (allocs[i])
+            assert_int_equal(mem_del_alloc(pool, allocs[i]), ALLOC_OK);
+    }
+    free(allocs);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, rest), ALLOC_OK);
+
+    check_metadata(pool, WORST_FIT, POOL_SIZE, 0, 0, 1);
+}
+
+/*******************************************/
+/***       10. FIXED_SIZE SCENARIOS      ***/
+/*******************************************/
+
+static int pool_fs_setup(void **state) {
+    alloc_status status;
+    pool_pt pool = NULL;
+
+    status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating pool of %u objects of %u bytes\n", 10, 100);
+    pool = mem_obj_pool_open(100, 10);
+    assert_non_null(pool);
+
+    *state = pool;
+
+    return 0;
+}
+
+static int pool_fs_teardown(void **state) {
+    pool_pt pool = *state;
+    alloc_status status;
+
+    INFO("Closing pool\n");
+    status = mem_pool_close(pool);
+    assert_int_equal(status, ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+
+    return 0;
+}
+
+static void test_pool_scenario30(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 30:
+     *
+     * 1. Allocate all 10 slots. They are handed out in address order.
+     * 2. Allocate 100 and 50 more. The pool is full, so both fail.
+     * 3. Deallocate 3 and 7. Deallocate 3 again, which fails.
+     * 4. Allocate 101. It is larger than a slot, so it fails.
+     * 5. Allocate 100 and 1. They reuse slots 7 and 3, last freed first.
+     * 6. Close the pool while allocations are live, which fails.
+     * 7. Clean up.
+     */
+
+    const unsigned NUM_ALLOCS = 10;
+
+    alloc_pt *allocs = (alloc_pt *) calloc(NUM_ALLOCS, sizeof(alloc_pt));
+    assert_non_null(allocs);
+
+    check_metadata(pool, FIXED_SIZE, 1000, 0, 0, 10);
+
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        allocs[i] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[i]);
+        assert_ptr_equal(allocs[i]->mem, pool->mem + 100 * i);
+        assert_int_equal(allocs[i]->size, 100);
+    }
+    assert_null(mem_new_alloc(pool, 100));
+    assert_null(mem_new_alloc(pool, 50));
+
+    check_metadata(pool, FIXED_SIZE, 1000, 1000, 10, 0);
+
+    assert_int_equal(mem_del_alloc(pool, allocs[3]), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, allocs[7]), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, allocs[3]), ALLOC_NOT_FREED);
+
+    pool_segment_t exp1[10] =
+            {
+                    {100, 1},
+                    {100, 1},
+                    {100, 1},
+                    {100, 0},
+                    {100, 1},
+                    {100, 1},
+                    {100, 1},
+                    {100, 0},
+                    {100, 1},
+                    {100, 1},
+            };
+    check_metadata(pool, FIXED_SIZE, 1000, 800, 8, 2);
+    check_pool(pool, exp1);
+
+    assert_null(mem_new_alloc(pool, 101));
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 700);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 1);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 300);
+    assert_int_equal(alloc1->size, 100);
+
+    check_metadata(pool, FIXED_SIZE, 1000, 1000, 10, 0);
+
+    assert_int_equal(mem_pool_close(pool), ALLOC_NOT_FREED);
+
+
+    // clean up
+    allocs[3] = alloc1;
+    allocs[7] = alloc0;
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        assert_int_equal(mem_del_alloc(pool, allocs[i]), ALLOC_OK);
+    }
+    free(allocs);
+
+    check_metadata(pool, FIXED_SIZE, 1000, 0, 0, 10);
+}
+
+/*******************************************/
+/***      11. SMALL-OBJECT SLABS         ***/
+/*******************************************/
+
+static int pool_slab_setup(void **state) {
+    alloc_status status;
+    pool_pt pool = NULL;
+
+    status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating pool of %lu bytes with policy %s and small-object slabs\n",
+         (long) POOL_SIZE, "FIRST_FIT");
+    pool = mem_pool_open_ex(POOL_SIZE, FIRST_FIT, POOL_SMALL_SLABS);
+    assert_non_null(pool);
+
+    *state = pool;
+
+    return 0;
+}
+
+static int pool_slab_teardown(void **state) {
+    pool_pt pool = *state;
+    alloc_status status;
+
+    INFO("Closing pool\n");
+    status = mem_pool_close(pool);
+    assert_int_equal(status, ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+
+    return 0;
+}
+
+static void test_pool_scenario31(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 31:
+     *
+     * 1. Allocate 100 x 40. They are 48-byte objects, 85 to a 4096-byte
+     *    slab page, so they take two pages.
+     * 2. Allocate 1000. It is too large for a slab and takes a node.
+     * 3. Deallocate 85-99. The second page is empty, but it is kept for
+     *    the next small allocations.
+     * 4. Deallocate 0-84. The first page is empty too and goes back to
+     *    the gaps. Deallocate 0 again, which fails.
+     * 5. Allocate 300. First fit takes the start of the pool.
+     * 6. Clean up.
+     */
+
+    const unsigned NUM_ALLOCS = 100;
+
+    alloc_pt *allocs = (alloc_pt *) calloc(NUM_ALLOCS, sizeof(alloc_pt));
+    assert_non_null(allocs);
+
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        allocs[i] = mem_new_alloc(pool, 40);
+        assert_non_null(allocs[i]);
+        assert_int_equal(allocs[i]->size, 48);
+    }
+    assert_ptr_equal(allocs[0]->mem, pool->mem);
+    assert_ptr_equal(allocs[84]->mem, pool->mem + 84 * 48);
+    assert_ptr_equal(allocs[85]->mem, pool->mem + 4096);
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 1000);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 8192);
+
+    pool_segment_t exp1[4] =
+            {
+                    {4096, 1},
+                    {4096, 1},
+                    {1000, 1},
+                    {POOL_SIZE - 9192, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 100 * 48 + 1000, 101, 1);
+    check_pool(pool, exp1);
+
+    for (int i=85; i<NUM_ALLOCS; ++i) {
+        assert_int_equal(mem_del_alloc(pool, allocs[i]), ALLOC_OK);
+    }
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 85 * 48 + 1000, 86, 1);
+    check_pool(pool, exp1);
+
+    for (int i=0; i<85; ++i) {
+        assert_int_equal(mem_del_alloc(pool, allocs[i]), ALLOC_OK);
+    }
+    assert_int_equal(mem_del_alloc(pool, allocs[0]), ALLOC_NOT_FREED);
+
+    pool_segment_t exp2[4] =
+            {
+                    {4096, 0},
+                    {4096, 1},
+                    {1000, 1},
+                    {POOL_SIZE - 9192, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 1000, 1, 2);
+    check_pool(pool, exp2);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 300);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem);
+
+
+    // clean up
+    free(allocs);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 2);
+}
+
+static void test_pool_scenario44(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 44:
+     *
+     * 1. Allocate 40, a 48-byte object.
+     * 2. Resize it to 20 and then to 48. Both fit the object, so it stays
+     *    in place and still reports the class size as its size, as when
+     *    it was allocated.
+     * 3. Deallocate it.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 40);
+    assert_non_null(alloc0);
+    assert_int_equal(alloc0->size, 48);
+
+    assert_ptr_equal(mem_realloc_alloc(pool, alloc0, 20), alloc0);
+    assert_int_equal(alloc0->size, 48);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 48, 1, 1);
+
+    assert_ptr_equal(mem_realloc_alloc(pool, alloc0, 48), alloc0);
+    assert_int_equal(alloc0->size, 48);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 48, 1, 1);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 1);
+}
+
+static void test_pool_scenario41(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 41:
+     *
+     * 1. Allocate 1000, then 257 x 16. The 16-byte objects fill one slab
+     *    page, 256 to a page, and start a second.
+     * 2. Deallocate the first 255 objects.
+     * 3. Deallocate 1000 and the last object of the first page in one
+     *    batch. The page is empty and goes back to the gaps, merged with
+     *    the gap the 1000 left, which is in the gap index only once.
+     * 4. Allocate 5000, which takes the merged gap at the start of the
+     *    pool only if it is indexed as one gap of its whole size.
+     * 5. Clean up, in one batch. Given again, the batch is not freed.
+     */
+
+    const unsigned NUM_ALLOCS = 257;
+
+    alloc_pt *allocs = (alloc_pt *) calloc(NUM_ALLOCS, sizeof(alloc_pt));
+    assert_non_null(allocs);
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 1000);
+    assert_non_null(alloc0);
+    for (int i=0; i<NUM_ALLOCS; ++i) {
+        allocs[i] = mem_new_alloc(pool, 16);
+        assert_non_null(allocs[i]);
+    }
+    assert_ptr_equal(allocs[0]->mem, pool->mem + 1000);
+    assert_ptr_equal(allocs[256]->mem, pool->mem + 5096);
+
+    for (int i=0; i<255; ++i) {
+        assert_int_equal(mem_del_alloc(pool, allocs[i]), ALLOC_OK);
+    }
+
+    alloc_pt batch[2] = { alloc0, allocs[255] };
+    assert_int_equal(mem_del_alloc_batch(pool, batch, 2), ALLOC_OK);
+
+    pool_segment_t exp1[3] =
+            {
+                    {5096, 0},
+                    {4096, 1},
+                    {POOL_SIZE - 9192, 0},
+            };
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 16, 1, 2);
+    check_pool(pool, exp1);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 5000);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem);
+
+
+    // clean up
+    batch[0] = alloc1;
+    batch[1] = allocs[256];
+    free(allocs);
+    assert_int_equal(mem_del_alloc_batch(pool, batch, 2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc_batch(pool, batch, 2), ALLOC_NOT_FREED);
+
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 2);
+}
+
+/*******************************************/
+/***         12. ARENA SCENARIOS         ***/
+/*******************************************/
+
+static int pool_arena_setup(void **state) {
+    alloc_status status;
+    pool_pt pool = NULL;
+
+    status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating pool of %lu bytes with policy %s\n",
+         (long) POOL_SIZE, "ARENA");
+    pool = mem_pool_open(POOL_SIZE, ARENA);
+    assert_non_null(pool);
+
+    *state = pool;
+
+    return 0;
+}
+
+static int pool_arena_teardown(void **state) {
+    pool_pt pool = *state;
+    alloc_status status;
+
+    INFO("Closing pool\n");
+    status = mem_pool_close(pool);
+    assert_int_equal(status, ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+
+    return 0;
+}
+
+static void test_pool_scenario32(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 32:
+     *
+     * 1. Allocate 100, 1, 50. Each takes a 16-byte record and its size
+     *    rounded up to 16, one after the other.
+     * 2. Deallocate 1, which an arena does not do.
+     * 3. Allocate the size of the pool, which fails.
+     * 4. Reset the pool. Allocate 10, which starts at the bottom again.
+     * 5. Allocate the rest of the pool.
+     * 6. Close the pool with the allocations live (teardown).
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 16);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 1);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 144);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc2);
+    assert_ptr_equal(alloc2->mem, pool->mem + 176);
+    assert_int_equal(alloc2->size, 50);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_NOT_FREED);
+    assert_null(mem_new_alloc(pool, POOL_SIZE));
+
+    pool_segment_t exp1[4] =
+            {
+                    {128, 1},
+                    {32, 1},
+                    {80, 1},
+                    {POOL_SIZE - 240, 0},
+            };
+    check_metadata(pool, ARENA, POOL_SIZE, 151, 3, 1);
+    check_pool(pool, exp1);
+
+    assert_int_equal(mem_pool_reset(pool), ALLOC_OK);
+    check_metadata(pool, ARENA, POOL_SIZE, 0, 0, 1);
+
+    alloc0 = mem_new_alloc(pool, 10);
+    assert_non_null(alloc0);
+    assert_ptr_equal(alloc0->mem, pool->mem + 16);
+
+    alloc1 = mem_new_alloc(pool, POOL_SIZE - 48);
+    assert_non_null(alloc1);
+    assert_null(mem_new_alloc(pool, 0));
+
+    pool_segment_t exp2[2] =
+            {
+                    {32, 1},
+                    {POOL_SIZE - 32, 1},
+            };
+    check_metadata(pool, ARENA, POOL_SIZE, POOL_SIZE - 38, 2, 0);
+    check_pool(pool, exp2);
+}
+
+static void test_pool_scenario33(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 33:
+     *
+     * 1. Allocate 100. Mark the pool (mark 1).
+     * 2. Allocate 200, 300. Mark the pool (mark 2).
+     * 3. Allocate 400. Roll back to mark 2, which drops 400.
+     * 4. Allocate 50, which takes the place of 400.
+     * 5. Roll back to mark 1, which drops 200, 300, 50.
+     * 6. Roll back to mark 2, which is above the top now and fails.
+     * 7. Roll back to mark 1 again, which changes nothing.
+     * 8. Allocate 10 aligned to 256.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    pool_mark_t mark1 = mem_pool_mark(pool);
+
+    assert_non_null(mem_new_alloc(pool, 200));
+    assert_non_null(mem_new_alloc(pool, 300));
+    pool_mark_t mark2 = mem_pool_mark(pool);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, 400);
+    assert_non_null(alloc1);
+    assert_ptr_equal(alloc1->mem, pool->mem + 688);
+    check_metadata(pool, ARENA, POOL_SIZE, 1000, 4, 1);
+
+    assert_int_equal(mem_pool_rollback(pool, mark2), ALLOC_OK);
+    check_metadata(pool, ARENA, POOL_SIZE, 600, 3, 1);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc2);
+    assert_ptr_equal(alloc2->mem, pool->mem + 688);
+
+    assert_int_equal(mem_pool_rollback(pool, mark1), ALLOC_OK);
+
+    pool_segment_t exp1[2] =
+            {
+                    {128, 1},
+                    {POOL_SIZE - 128, 0},
+            };
+    check_metadata(pool, ARENA, POOL_SIZE, 100, 1, 1);
+    check_pool(pool, exp1);
+
+    assert_int_equal(mem_pool_rollback(pool, mark2), ALLOC_FAIL);
+    assert_int_equal(mem_pool_rollback(pool, mark1), ALLOC_OK);
+    check_metadata(pool, ARENA, POOL_SIZE, 100, 1, 1);
+    check_pool(pool, exp1);
+
+    // an aligned allocation pads the top, and the padding goes with it
+    alloc1 = mem_new_alloc_aligned(pool, 10, 256);
+    assert_non_null(alloc1);
+    assert_int_equal((uintptr_t) alloc1->mem % 256, 0);
+
+    pool_segment_t exp2[3] =
+            {
+                    {128, 1},
+                    {alloc1->mem + 16 - (pool->mem + 128), 1},
+                    {pool->mem + POOL_SIZE - (alloc1->mem + 16), 0},
+            };
+    check_metadata(pool, ARENA, POOL_SIZE, 110, 2, 1);
+    check_pool(pool, exp2);
+}
+
+static void test_pool_scenario45(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 45:
+     *
+     * 1. Mark the pool (mark 1). Allocate 100. Mark the pool (mark 2).
+     * 2. Roll back to mark 1, which drops 100 and mark 2.
+     * 3. Allocate 20 and 200, so the top is above mark 2 again. Rolling
+     *    back to mark 2 fails, as its top is inside 200.
+     * 4. Mark the pool (mark 3), at the same depth as mark 2 was. Rolling
+     *    back to mark 2 still fails, and to mark 3 works.
+     * 5. Reset the pool, and allocate 300. Rolling back to mark 1 or
+     *    mark 3 fails.
+     */
+
+    pool_mark_t mark1 = mem_pool_mark(pool);
+    assert_non_null(mem_new_alloc(pool, 100));
+    pool_mark_t mark2 = mem_pool_mark(pool);
+    assert_int_equal(mark2.top, 128);
+
+    assert_int_equal(mem_pool_rollback(pool, mark1), ALLOC_OK);
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 20);
+    alloc_pt alloc1 = mem_new_alloc(pool, 200);
+    assert_non_null(alloc0);
+    assert_non_null(alloc1);
+    assert_int_equal(mem_pool_rollback(pool, mark2), ALLOC_FAIL);
+
+    pool_segment_t exp1[3] =
+            {
+                    {48, 1},
+                    {224, 1},
+                    {POOL_SIZE - 272, 0},
+            };
+    check_metadata(pool, ARENA, POOL_SIZE, 220, 2, 1);
+    check_pool(pool, exp1);
+
+    pool_mark_t mark3 = mem_pool_mark(pool);
+    assert_int_equal(mark3.depth, mark2.depth);
+    assert_int_equal(mem_pool_rollback(pool, mark2), ALLOC_FAIL);
+    assert_non_null(mem_new_alloc(pool, 10));
+    assert_int_equal(mem_pool_rollback(pool, mark3), ALLOC_OK);
+    check_metadata(pool, ARENA, POOL_SIZE, 220, 2, 1);
+    check_pool(pool, exp1);
+
+    assert_int_equal(mem_pool_reset(pool), ALLOC_OK);
+    assert_non_null(mem_new_alloc(pool, 300));
+    assert_int_equal(mem_pool_rollback(pool, mark1), ALLOC_FAIL);
+    assert_int_equal(mem_pool_rollback(pool, mark3), ALLOC_FAIL);
+    check_metadata(pool, ARENA, POOL_SIZE, 300, 1, 1);
+}
+
+static void test_pool_scenario42(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 42:
+     *
+     * 1. Allocate 16. Mark the pool.
+     * 2. Resize 16 to 1000. It was made before the mark, so it moves
+     *    instead of growing in place across the mark.
+     * 3. Roll back to the mark, which drops the moved copy. 16 is as it
+     *    was.
+     * 4. Allocate 64, which goes right after 16. Resize it to 1000,
+     *    which it does in place, since it was made after the mark.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 16);
+    assert_non_null(alloc0);
+    memset(alloc0->mem, 'x', 16);
+    pool_mark_t mark = mem_pool_mark(pool);
+
+    alloc_pt alloc1 = mem_realloc_alloc(pool, alloc0, 1000);
+    assert_non_null(alloc1);
+    assert_ptr_not_equal(alloc1, alloc0);
+    assert_int_equal(alloc0->size, 16);
+    assert_ptr_equal(alloc1->mem, pool->mem + 48);
+    assert_int_equal(alloc1->mem[15], 'x');
+
+    assert_int_equal(mem_pool_rollback(pool, mark), ALLOC_OK);
+    check_metadata(pool, ARENA, POOL_SIZE, 16, 1, 1);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 64);
+    assert_non_null(alloc2);
+    assert_ptr_equal(alloc2->mem, pool->mem + 48);
+    assert_ptr_equal(mem_realloc_alloc(pool, alloc2, 1000), alloc2);
+    assert_int_equal(alloc0->mem[15], 'x');
+
+    pool_segment_t exp1[3] =
+            {
+                    {32, 1},
+                    {1024, 1},
+                    {POOL_SIZE - 1056, 0},
+            };
+    check_metadata(pool, ARENA, POOL_SIZE, 1016, 2, 1);
+    check_pool(pool, exp1);
+}
+
+/*******************************************/
+/***        13. GROWABLE POOLS           ***/
+/*******************************************/
+
+static int pool_grow_setup(void **state) {
+    alloc_status status;
+    pool_pt pool = NULL;
+
+    status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating growable pool of %lu bytes with policy %s\n",
+         (long) GROW_POOL_SIZE, "FIRST_FIT");
+    pool = mem_pool_open_ex(GROW_POOL_SIZE, FIRST_FIT, POOL_GROWABLE);
+    assert_non_null(pool);
+
+    *state = pool;
+
+    return 0;
+}
+
+static int pool_grow_teardown(void **state) {
+    pool_pt pool = *state;
+    alloc_status status;
+
+    INFO("Closing pool\n");
+    status = mem_pool_close(pool);
+    assert_int_equal(status, ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+
+    return 0;
+}
+
+static void test_pool_scenario39(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 39:
+     *
+     * 1. Allocate 600 and 300, which leaves a gap of 100.
+     * 2. Allocate 500. No gap fits, so the pool adds an extent twice its
+     *    size, and the allocation is at its start.
+     * 3. Allocate 5000. The next extent would be 4000, so it is 5000.
+     * 4. Deallocate 300. It merges with the gap of 100, but not with
+     *    anything in the next extent.
+     * 5. Deallocate 500. It merges with the rest of its extent only.
+     * 6. Clean up. The pool is a gap per extent.
+     */
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 600);
+    alloc_pt alloc1 = mem_new_alloc(pool, 300);
+    assert_non_null(alloc0);
+    assert_non_null(alloc1);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 500);
+    assert_non_null(alloc2);
+    assert_true(alloc2->mem < pool->mem || alloc2->mem >= pool->mem + GROW_POOL_SIZE);
+
+    pool_segment_t exp1[5] =
+            {
+                    {600, 1},
+                    {300, 1},
+                    {100, 0},
+                    {500, 1},
+                    {1500, 0},
+            };
+    check_metadata(pool, FIRST_FIT, 3000, 1400, 3, 2);
+    check_pool(pool, exp1);
+
+    alloc_pt alloc3 = mem_new_alloc(pool, 5000);
+    assert_non_null(alloc3);
+    check_metadata(pool, FIRST_FIT, 8000, 6400, 4, 2);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+
+    pool_segment_t exp2[4] =
+            {
+                    {600, 1},
+                    {400, 0},
+                    {2000, 0},
+                    {5000, 1},
+            };
+    check_metadata(pool, FIRST_FIT, 8000, 5600, 2, 2);
+    check_pool(pool, exp2);
+
+
+    // clean up
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+
+    check_metadata(pool, FIRST_FIT, 8000, 0, 0, 3);
+}
+
+/*******************************************/
+/***         14. HUGE PAGES              ***/
+/*******************************************/
+
+static void test_pool_huge_pages(void **state) {
+    (void) state; /* unused */
+
+    /*
+     * Pools opened with POOL_HUGE_PAGES work as any other. On Linux the
+     * pool starts at a 2 MiB boundary and is resized in 2 MiB steps. Buddy
+     * pools and arenas take the option, though not the others.
+     */
+
+    assert_int_equal(mem_init(), ALLOC_OK);
+
+    pool_pt pool = mem_pool_open_ex(POOL_SIZE, FIRST_FIT, POOL_HUGE_PAGES | POOL_SMALL_SLABS);
+    assert_non_null(pool);
+#ifdef __linux__
+    assert_int_equal((uintptr_t) pool->mem % (2 << 20), 0);
+#endif
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 1);
+
+    alloc_pt alloc0 = mem_new_alloc(pool, POOL_SIZE);
+    assert_non_null(alloc0);
+    memset(alloc0->mem, 0x5a, POOL_SIZE);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+#ifdef __linux__
+    assert_int_equal(mem_pool_resize(pool, 3 * POOL_SIZE), ALLOC_OK);
+    alloc0 = mem_new_alloc(pool, 3 * POOL_SIZE);
+    assert_non_null(alloc0);
+    memset(alloc0->mem, 0x5a, 3 * POOL_SIZE);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_pool_resize(pool, POOL_SIZE), ALLOC_OK);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 1);
+#endif
+    assert_int_equal(mem_pool_close(pool), ALLOC_OK);
+
+    pool_pt buddy = mem_pool_open_ex(POOL_SIZE, BUDDY, POOL_HUGE_PAGES);
+    pool_pt arena = mem_pool_open_ex(POOL_SIZE, ARENA, POOL_HUGE_PAGES);
+    assert_non_null(buddy);
+    assert_non_null(arena);
+    assert_null(mem_pool_open_ex(POOL_SIZE, ARENA, POOL_HUGE_PAGES | POOL_GROWABLE));
+    assert_int_equal(mem_pool_close(buddy), ALLOC_OK);
+    assert_int_equal(mem_pool_close(arena), ALLOC_OK);
+
+    assert_int_equal(mem_free(), ALLOC_OK);
+}
+
+/*******************************************/
+/***        15. PREFAULTED POOLS         ***/
+/*******************************************/
+
+static void test_pool_prefault(void **state) {
+    (void) state; /* unused */
+
+    /*
+     * Pools opened with POOL_PREFAULT report the time their pages took to
+     * populate, which a pool without the option leaves at 0. On Linux a
+     * pool resized to grow populates the new pages too.
+     */
+
+    assert_int_equal(mem_init(), ALLOC_OK);
+
+    pool_pt plain = mem_pool_open(POOL_SIZE, BEST_FIT);
+    pool_pt pool = mem_pool_open_ex(POOL_SIZE, BEST_FIT, POOL_PREFAULT);
+    pool_pt arena = mem_pool_open_ex(POOL_SIZE, ARENA, POOL_PREFAULT | POOL_HUGE_PAGES);
+    assert_non_null(plain);
+    assert_non_null(pool);
+    assert_non_null(arena);
+    assert_true(plain->prefault_ns == 0);
+    assert_true(pool->prefault_ns > 0);
+    assert_true(arena->prefault_ns > 0);
+    check_metadata(pool, BEST_FIT, POOL_SIZE, 0, 0, 1);
+
+    alloc_pt alloc0 = mem_new_alloc(pool, POOL_SIZE);
+    assert_non_null(alloc0);
+    memset(alloc0->mem, 0x5a, POOL_SIZE);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+#ifdef __linux__
+    unsigned long long open_ns = pool->prefault_ns;
+    assert_int_equal(mem_pool_resize(pool, 4 * POOL_SIZE), ALLOC_OK);
+    assert_true(pool->prefault_ns > open_ns);
+#endif
+
+    assert_int_equal(mem_pool_close(plain), ALLOC_OK);
+    assert_int_equal(mem_pool_close(pool), ALLOC_OK);
+    assert_int_equal(mem_pool_close(arena), ALLOC_OK);
+
+    assert_int_equal(mem_free(), ALLOC_OK);
+}
+
+/*******************************************/
+/***         16. STRESS TEST             ***/
+/*******************************************/
+
+void test_pool_stresstest(void **state) {
+    (void) state; /* unused */
+
+    const unsigned num_pools = 200;
+    const unsigned num_allocations = 1000;
+    const unsigned min_alloc_size = 10;
+    const unsigned pool_size =
+            (num_allocations / 2) *
+            (2 * min_alloc_size + (num_allocations - 1) * min_alloc_size);
+    assert_int_equal(pool_size, 5005000);
+
+
+    pool_pt pools[num_pools];
+    alloc_pt allocations[num_pools][num_allocations];
+
+    /*
+     * NOTE: This works because the node heap grows by adding
+     * 512-node chunks instead of reallocating, so the allocation
+     * records handed to the user never move while the pool is open.
      */
 
     /*
@@ -2408,7 +4540,7 @@ void test_pool_stresstest(void **state) {
 
 
 /*******************************************/
-/***         6. DRIVER ROUTINE           ***/
+/***        17. DRIVER ROUTINE           ***/
 /*******************************************/
 
 int run_test_suite() {
@@ -2417,6 +4549,7 @@ int run_test_suite() {
             cmocka_unit_test(test_pool_smoketest),
 
             cmocka_unit_test(test_pool_nonempty),
+            cmocka_unit_test(test_pool_bad_free),
 
             cmocka_unit_test_setup_teardown(test_pool_ff_metadata, pool_ff_setup, pool_ff_teardown),
             cmocka_unit_test_setup_teardown(test_pool_bf_metadata, pool_bf_setup, pool_bf_teardown),
@@ -2432,6 +4565,14 @@ int run_test_suite() {
             cmocka_unit_test_setup_teardown(test_pool_scenario08, pool_ff_setup, pool_ff_teardown),
             cmocka_unit_test_setup_teardown(test_pool_scenario09, pool_ff_setup, pool_ff_teardown),
             cmocka_unit_test_setup_teardown(test_pool_scenario10, pool_ff_setup, pool_ff_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario27, pool_ff_setup, pool_ff_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario34, pool_ff_setup, pool_ff_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario35, pool_ff_setup, pool_ff_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario36, pool_ff_setup, pool_ff_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario37, pool_ff_setup, pool_ff_teardown),
+#ifdef __linux__
+            cmocka_unit_test_setup_teardown(test_pool_scenario40, pool_ff_setup, pool_ff_teardown),
+#endif
 
             cmocka_unit_test_setup_teardown(test_pool_scenario11, pool_bf_setup, pool_bf_teardown),
             cmocka_unit_test_setup_teardown(test_pool_scenario12, pool_bf_setup, pool_bf_teardown),
@@ -2442,9 +4583,38 @@ int run_test_suite() {
             cmocka_unit_test_setup_teardown(test_pool_scenario17, pool_bf_setup, pool_bf_teardown),
             cmocka_unit_test_setup_teardown(test_pool_scenario18, pool_bf_setup, pool_bf_teardown),
             cmocka_unit_test_setup_teardown(test_pool_scenario19, pool_bf_setup, pool_bf_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario20, pool_bf_setup, pool_bf_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario38, pool_bf_setup, pool_bf_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario21, pool_sf_setup, pool_sf_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario22, pool_sf_setup, pool_sf_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario23, pool_tlsf_setup, pool_tlsf_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario24, pool_tlsf_setup, pool_tlsf_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario25, pool_buddy_setup, pool_buddy_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario26, pool_buddy_setup, pool_buddy_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario43, pool_buddy_setup, pool_buddy_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario28, pool_nf_setup, pool_nf_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario29, pool_wf_setup, pool_wf_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario30, pool_fs_setup, pool_fs_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario31, pool_slab_setup, pool_slab_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario41, pool_slab_setup, pool_slab_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario44, pool_slab_setup, pool_slab_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario32, pool_arena_setup, pool_arena_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario33, pool_arena_setup, pool_arena_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario42, pool_arena_setup, pool_arena_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario45, pool_arena_setup, pool_arena_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario39, pool_grow_setup, pool_grow_teardown),
+
+            cmocka_unit_test(test_pool_huge_pages),
+            cmocka_unit_test(test_pool_prefault),
 
             // do not uncomment until the project is changed to return the allocation address
-//            cmocka_unit_test(test_pool_stresstest),
+            cmocka_unit_test(test_pool_stresstest),
     };
 
     return cmocka_run_group_tests_name("pool_test_suite", tests, NULL, NULL);